@@ -3,8 +3,12 @@
 #include <string.h>
 #include <syscall.h>
 
+/* Most commands in one pipeline. */
+#define PIPELINE_MAX 8
+
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +34,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -102,3 +108,74 @@ backspace (char **pos, char line[])
   else
     return false;
 }
+
+/* Runs the commands of COMMAND, separated by `|', all at once,
+   with the standard output of each connected to the standard
+   input of the next by a pipe, and waits for them all. */
+static void
+run_pipeline (char *command) 
+{
+  char *stages[PIPELINE_MAX];
+  pid_t pids[PIPELINE_MAX];
+  int stage_cnt = 0;
+  int read_fd = -1;
+  char *stage, *save_ptr;
+  int i;
+
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      while (*stage == ' ')
+        stage++;
+      if (stage_cnt == PIPELINE_MAX)
+        {
+          printf ("too many commands in pipeline\n");
+          return;
+        }
+      stages[stage_cnt++] = stage;
+    }
+
+  for (i = 0; i < stage_cnt; i++)
+    {
+      int fds[2];
+
+      /* Read from the previous command's pipe, write to the next
+         command's.  The children inherit these as their standard
+         input and output. */
+      if (read_fd >= 0)
+        {
+          dup2 (read_fd, STDIN_FILENO);
+          close (read_fd);
+          read_fd = -1;
+        }
+      if (i < stage_cnt - 1)
+        {
+          if (!pipe (fds))
+            {
+              close (STDIN_FILENO);
+              printf ("pipe failed\n");
+              stage_cnt = i;
+              break;
+            }
+          dup2 (fds[1], STDOUT_FILENO);
+          close (fds[1]);
+          /* This command must not hold the read end of its own
+             output, or it would never see the reader exit. */
+          read_fd = fds[0];
+          cloexec (read_fd, true);
+        }
+      pids[i] = exec (stages[i]);
+
+      /* Back to the console.  Only the children hold the pipes. */
+      close (STDIN_FILENO);
+      close (STDOUT_FILENO);
+    }
+  if (read_fd >= 0)
+    close (read_fd);
+
+  for (i = 0; i < stage_cnt; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+    else
+      printf ("\"%s\": exec failed\n", stages[i]);
+}
@@ -1,6 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/pipe.h"
 #include "threads/malloc.h"
 
 /* An open file. */
@@ -9,6 +10,9 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* Number of openers sharing this file. */
+    struct pipe *pipe;          /* Pipe, if this is one of its ends. */
+    bool pipe_write_end;        /* Is this the write end of PIPE? */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +27,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
@@ -33,22 +38,91 @@ file_open (struct inode *inode)
     }
 }
 
-/* Opens and returns a new file for the same inode as FILE.
+/* Opens both ends of a new pipe, storing the end to read from
+   in *READ_END and the end to write to in *WRITE_END.  Returns
+   true if successful, false if memory is not available. */
+bool
+file_open_pipe (struct file **read_end, struct file **write_end) 
+{
+  struct pipe *pipe = pipe_create ();
+  struct file *ends[2];
+  int i;
+
+  if (pipe == NULL)
+    return false;
+  ends[0] = calloc (1, sizeof *ends[0]);
+  ends[1] = calloc (1, sizeof *ends[1]);
+  if (ends[0] == NULL || ends[1] == NULL)
+    {
+      free (ends[0]);
+      free (ends[1]);
+      pipe_close (pipe, false);
+      pipe_close (pipe, true);
+      return false;
+    }
+  for (i = 0; i < 2; i++)
+    {
+      ends[i]->pipe = pipe;
+      ends[i]->pipe_write_end = i == 1;
+      ends[i]->ref_cnt = 1;
+    }
+  *read_end = ends[0];
+  *write_end = ends[1];
+  return true;
+}
+
+/* Returns true if FILE is an end of a pipe. */
+bool
+file_is_pipe (struct file *file) 
+{
+  return file->pipe != NULL;
+}
+
+/* Opens and returns a new file for the same inode as FILE, or a
+   new end of the same kind for an end of a pipe.
    Returns a null pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file) 
 {
-  return file_open (inode_reopen (file->inode));
+  struct file *end;
+
+  if (file->pipe == NULL)
+    return file_open (inode_reopen (file->inode));
+  end = calloc (1, sizeof *end);
+  if (end != NULL)
+    {
+      end->pipe = file->pipe;
+      end->pipe_write_end = file->pipe_write_end;
+      end->ref_cnt = 1;
+      pipe_reopen (end->pipe, end->pipe_write_end);
+    }
+  return end;
+}
+
+/* Returns FILE with another reference to it, sharing its
+   position, as for a duplicated file descriptor.  Each reference
+   must be closed with file_close().  REF_CNT is not locked, so
+   all references must belong to the same process. */
+struct file *
+file_dup (struct file *file) 
+{
+  file->ref_cnt++;
+  return file;
 }
 
 /* Closes FILE. */
 void
 file_close (struct file *file) 
 {
-  if (file != NULL)
+  if (file != NULL && --file->ref_cnt == 0)
     {
-      file_allow_write (file);
-      inode_close (file->inode);
+      if (file->pipe != NULL)
+        pipe_close (file->pipe, file->pipe_write_end);
+      else
+        {
+          file_allow_write (file);
+          inode_close (file->inode);
+        }
       free (file); 
     }
 }
@@ -64,11 +138,17 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   Reading an end of a pipe waits for data; reading its write
+   end fails with -1. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  if (file->pipe != NULL)
+    return file->pipe_write_end ? -1 : pipe_read (file->pipe, buffer, size);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -90,11 +170,17 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
    which may be less than SIZE if end of file is reached.
    (Normally we'd grow the file in that case, but file growth is
    not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   Writing an end of a pipe waits for room; writing its read end
+   fails with -1. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  if (file->pipe != NULL)
+    return file->pipe_write_end ? pipe_write (file->pipe, buffer, size) : -1;
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -140,11 +226,13 @@ file_allow_write (struct file *file)
     }
 }
 
-/* Returns the size of FILE in bytes. */
+/* Returns the size of FILE in bytes, which is 0 for a pipe. */
 off_t
 file_length (struct file *file) 
 {
   ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return 0;
   return inode_length (file->inode);
 }
 
@@ -0,0 +1,153 @@
+#include "filesys/pipe.h"
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+/* A pipe.  Bytes written to the write end are read, in order,
+   from the read end through a ring buffer. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readable;  /* Data arrived or write end closed. */
+    struct condition writable;  /* Room freed or read end closed. */
+    uint8_t *buffer;            /* Ring buffer of PIPE_SIZE bytes. */
+    size_t head;                /* Total bytes read. */
+    size_t tail;                /* Total bytes written. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+  };
+
+/* Creates a pipe with one read end and one write end open.  Returns a null pointer if
+   memory is not available. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *pipe = malloc (sizeof *pipe);
+  if (pipe == NULL)
+    return NULL;
+  pipe->buffer = palloc_get_page (0);
+  if (pipe->buffer == NULL)
+    {
+      free (pipe);
+      return NULL;
+    }
+  lock_init (&pipe->lock);
+  cond_init (&pipe->readable);
+  cond_init (&pipe->writable);
+  pipe->head = pipe->tail = 0;
+  pipe->readers = pipe->writers = 1;
+  return pipe;
+}
+
+/* Reads up to SIZE bytes from PIPE into BUFFER, waiting until at
+   least one byte is available.  Returns the number of bytes
+   read, or 0 at end of file, once the pipe is empty and all of
+   its write ends are closed. */
+off_t
+pipe_read (struct pipe *pipe, void *buffer_, off_t size) 
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  lock_acquire (&pipe->lock);
+  while (pipe->head == pipe->tail && pipe->writers > 0 && size > 0)
+    cond_wait (&pipe->readable, &pipe->lock);
+  while (bytes_read < size && pipe->head != pipe->tail)
+    {
+      /* Bytes up to the end of the ring or of the data. */
+      size_t ofs = pipe->head % PIPE_SIZE;
+      size_t chunk_size = pipe->tail - pipe->head;
+      if (chunk_size > PIPE_SIZE - ofs)
+        chunk_size = PIPE_SIZE - ofs;
+      if (chunk_size > (size_t) (size - bytes_read))
+        chunk_size = size - bytes_read;
+
+      memcpy (buffer + bytes_read, pipe->buffer + ofs, chunk_size);
+      pipe->head += chunk_size;
+      bytes_read += chunk_size;
+    }
+  if (bytes_read > 0)
+    cond_broadcast (&pipe->writable, &pipe->lock);
+  lock_release (&pipe->lock);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into PIPE, waiting for room
+   whenever the pipe is full.  Returns the number of bytes
+   written, which is less than SIZE only if all read ends are
+   closed, or -1 if they are closed before any byte is
+   written. */
+off_t
+pipe_write (struct pipe *pipe, const void *buffer_, off_t size) 
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  lock_acquire (&pipe->lock);
+  while (bytes_written < size && pipe->readers > 0)
+    {
+      size_t ofs = pipe->tail % PIPE_SIZE;
+      size_t chunk_size;
+
+      if (pipe->tail - pipe->head == PIPE_SIZE)
+        {
+          cond_wait (&pipe->writable, &pipe->lock);
+          continue;
+        }
+
+      /* Bytes up to the end of the ring or of the free space. */
+      chunk_size = PIPE_SIZE - (pipe->tail - pipe->head);
+      if (chunk_size > PIPE_SIZE - ofs)
+        chunk_size = PIPE_SIZE - ofs;
+      if (chunk_size > (size_t) (size - bytes_written))
+        chunk_size = size - bytes_written;
+
+      memcpy (pipe->buffer + ofs, buffer + bytes_written, chunk_size);
+      pipe->tail += chunk_size;
+      bytes_written += chunk_size;
+      cond_broadcast (&pipe->readable, &pipe->lock);
+    }
+  lock_release (&pipe->lock);
+  return bytes_written > 0 || size <= 0 ? bytes_written : -1;
+}
+
+/* Opens another write end of PIPE if WRITE_END is true,
+   otherwise another read end. */
+void
+pipe_reopen (struct pipe *pipe, bool write_end) 
+{
+  lock_acquire (&pipe->lock);
+  if (write_end)
+    pipe->writers++;
+  else
+    pipe->readers++;
+  lock_release (&pipe->lock);
+}
+
+/* Closes a write end of PIPE if WRITE_END is true, otherwise a
+   read end.  Closing the last end of either kind wakes any
+   process waiting on the other kind.  Frees PIPE once all of its
+   ends are closed. */
+void
+pipe_close (struct pipe *pipe, bool write_end) 
+{
+  bool destroy;
+
+  lock_acquire (&pipe->lock);
+  if (write_end)
+    pipe->writers--;
+  else
+    pipe->readers--;
+  cond_broadcast (&pipe->readable, &pipe->lock);
+  cond_broadcast (&pipe->writable, &pipe->lock);
+  destroy = pipe->readers == 0 && pipe->writers == 0;
+  lock_release (&pipe->lock);
+
+  if (destroy)
+    {
+      palloc_free_page (pipe->buffer);
+      free (pipe);
+    }
+}
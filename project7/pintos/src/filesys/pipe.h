@@ -0,0 +1,18 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+/* Bytes a pipe holds before writers block. */
+#define PIPE_SIZE 4096
+
+struct pipe;
+
+struct pipe *pipe_create (void);
+off_t pipe_read (struct pipe *, void *, off_t size);
+off_t pipe_write (struct pipe *, const void *, off_t size);
+void pipe_reopen (struct pipe *, bool write_end);
+void pipe_close (struct pipe *, bool write_end);
+
+#endif /* filesys/pipe.h */
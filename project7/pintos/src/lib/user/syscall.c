@@ -1,16 +1,45 @@
 #include <syscall.h>
+#include <stdint.h>
 #include "../syscall-nr.h"
 
+/* Entry stubs in syscall-entry.S. */
+void syscall_int (void);
+void syscall_sysenter (void);
+
+/* Stub used to enter the kernel.  The process starts out with
+   the trap and switches to SYSENTER in _start() if the CPU
+   supports it. */
+void (*syscall_entry) (void) = syscall_int;
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & (1 << 11)) != 0;
+}
+
+/* Makes system calls enter the kernel with SYSENTER if FAST is
+   true and the CPU supports it, otherwise with "int $0x30".
+   Returns true if SYSENTER is now in use. */
+bool
+syscall_fast (bool fast)
+{
+  syscall_entry = fast && cpu_has_sysenter () ? syscall_sysenter : syscall_int;
+  return syscall_entry == syscall_sysenter;
+}
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; call *syscall_entry; addl $4, %%esp"       \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                                     \
           retval;                                               \
         })
 
@@ -20,11 +49,11 @@
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+            ("pushl %[arg0]; pushl %[number]; call *syscall_entry; addl $8, %%esp" \
                : "=a" (retval)                                           \
                : [number] "i" (NUMBER),                                  \
                  [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
+               : "ecx", "edx", "memory");                                              \
           retval;                                                        \
         })
 
@@ -35,12 +64,12 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; call *syscall_entry; addl $12, %%esp"      \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "g" (ARG0),                             \
                  [arg1] "g" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                                     \
           retval;                                               \
         })
 
@@ -51,13 +80,13 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; call *syscall_entry; addl $16, %%esp"      \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "g" (ARG0),                             \
                  [arg1] "g" (ARG1),                             \
                  [arg2] "g" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                                     \
           retval;                                               \
         })
 
@@ -182,3 +211,51 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+int
+dup2 (int oldfd, int newfd)
+{
+  return syscall2 (SYS_DUP2, oldfd, newfd);
+}
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+shm_create (unsigned size)
+{
+  return syscall1 (SYS_SHM_CREATE, size);
+}
+
+bool
+shm_attach (int id, void *addr)
+{
+  return syscall2 (SYS_SHM_ATTACH, id, addr);
+}
+
+bool
+shm_detach (void *addr)
+{
+  return syscall1 (SYS_SHM_DETACH, addr);
+}
+
+bool
+cloexec (int fd, bool on)
+{
+  return syscall2 (SYS_CLOEXEC, fd, on);
+}
+
+void
+null_syscall (void)
+{
+  syscall0 (SYS_NULL);
+}
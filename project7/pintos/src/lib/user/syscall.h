@@ -45,4 +45,15 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+int dup2 (int oldfd, int newfd);
+bool pipe (int fds[2]);
+int shm_create (unsigned size);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+bool cloexec (int fd, bool on);
+void null_syscall (void);
+bool syscall_fast (bool);
+
 #endif /* lib/user/syscall.h */
@@ -1,11 +1,12 @@
 /* Child process run by multi-child-fd test.
 
    Attempts to close the file descriptor passed as the first
-   command-line argument.  This is invalid, because file
-   descriptors are not inherited in Pintos.  Two results are
-   allowed: either the system call should return without taking
-   any action, or the kernel should terminate the process with a
-   -1 exit code. */
+   command-line argument.  File descriptors are inherited across
+   exec, so this closes only the child's copy.  In kernels
+   without inheritance the descriptor is invalid, and two results
+   are allowed: either the system call should return without
+   taking any action, or the kernel should terminate the process
+   with a -1 exit code. */
 
 #include <ctype.h>
 #include <stdio.h>
@@ -0,0 +1,44 @@
+/* Child process run by pipe-exec test.
+
+   Checks that the write end of a pipe, whose descriptor is the
+   second command-line argument, was closed on exec, then reads
+   the pipe from the descriptor given as the first argument until
+   end of file, checking the bytes written by the parent. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/userprog/pipe.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  char buf[PIPE_CHUNK];
+  int read_fd, total = 0;
+  int n, i;
+
+  msg ("begin");
+  if (!isdigit (*argv[1]) || !isdigit (*argv[2]))
+    fail ("bad command-line arguments");
+  read_fd = atoi (argv[1]);
+  if (filesize (atoi (argv[2])) != -1)
+    fail ("write end is still open after exec");
+
+  while ((n = read (read_fd, buf, sizeof buf)) > 0)
+    {
+      for (i = 0; i < n; i++)
+        if (buf[i] != pipe_byte (total + i))
+          fail ("byte %d is %d, not %d", total + i, buf[i],
+                pipe_byte (total + i));
+      total += n;
+    }
+  if (n < 0)
+    fail ("read failed");
+  msg ("read %d bytes before end of file", total);
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,37 @@
+/* Duplicates a file descriptor with dup2 and checks that both
+   descriptors share one file position, that the duplicate stays
+   usable after the original is closed, and that dup2 onto an open
+   descriptor closes it first. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[5];
+  int fd, other;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (dup2 (fd, 40) == 40, "dup2 to fd 40");
+  if (read (fd, buf, sizeof buf) != sizeof buf)
+    fail ("read from original fd failed");
+  if (tell (40) != sizeof buf)
+    fail ("duplicate fd is at %u, not %zu", tell (40), sizeof buf);
+  msg ("descriptors share position");
+
+  close (fd);
+  if (read (40, buf, sizeof buf) != sizeof buf
+      || memcmp (buf, sample + sizeof buf, sizeof buf))
+    fail ("read from duplicate after close failed");
+  msg ("duplicate survives close of original");
+
+  CHECK ((other = open ("sample.txt")) == fd, "open reuses lowest fd");
+  CHECK (dup2 (other, 40) == 40, "dup2 onto open fd");
+  if (tell (40) != 0)
+    fail ("fd 40 still refers to old file");
+  CHECK (dup2 (123, 41) == -1, "dup2 from bad fd fails");
+}
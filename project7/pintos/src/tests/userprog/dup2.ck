@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup2) begin
+(dup2) open "sample.txt"
+(dup2) dup2 to fd 40
+(dup2) descriptors share position
+(dup2) duplicate survives close of original
+(dup2) open reuses lowest fd
+(dup2) dup2 onto open fd
+(dup2) dup2 from bad fd fails
+(dup2) end
+dup2: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Times a system call that does nothing, entering the kernel
+   first with "int $0x30" and then with SYSENTER, and checks that
+   system calls still work after switching back and forth. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CALL_CNT 10000
+
+/* Returns the average cycles taken by a null system call. */
+static uint64_t
+time_null (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < CALL_CNT; i++)
+    null_syscall ();
+  return (rdtsc () - start) / CALL_CNT;
+}
+
+void
+test_main (void) 
+{
+  syscall_fast (false);
+  msg ("int $0x30: %llu cycles per call", time_null ());
+  if (syscall_fast (true))
+    msg ("sysenter: %llu cycles per call", time_null ());
+  else
+    msg ("sysenter: unsupported");
+  CHECK (create ("quux", 0), "create \"quux\"");
+  CHECK (remove ("quux"), "remove \"quux\"");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run, and not every CPU has
+# SYSENTER.
+s/: \d+ cycles/: N cycles/ foreach @output;
+s/: unsupported$/: N cycles per call/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(null-bench) begin
+(null-bench) int $0x30: N cycles per call
+(null-bench) sysenter: N cycles per call
+(null-bench) create "quux"
+(null-bench) remove "quux"
+(null-bench) end
+EOF
+pass;
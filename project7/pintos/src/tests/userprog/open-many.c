@@ -0,0 +1,35 @@
+/* Opens many files at once, more than the initial descriptor
+   table holds, then closes them and opens and closes a file many
+   times.  Closed descriptors must be reused, lowest first, so
+   the table never runs out. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 100
+#define REOPEN_CNT 3000
+
+void
+test_main (void) 
+{
+  int fds[OPEN_CNT];
+  int i, fd;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    if ((fds[i] = open ("sample.txt")) < 2)
+      fail ("open #%d failed", i);
+  msg ("opened sample.txt %d times", OPEN_CNT);
+  for (i = 0; i < OPEN_CNT; i++)
+    close (fds[i]);
+  msg ("closed all");
+
+  for (i = 0; i < REOPEN_CNT; i++)
+    {
+      fd = open ("sample.txt");
+      if (fd != fds[0])
+        fail ("open #%d returned %d, not %d", i, fd, fds[0]);
+      close (fd);
+    }
+  msg ("opened and closed sample.txt %d times", REOPEN_CNT);
+}
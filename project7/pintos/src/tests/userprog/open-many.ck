@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened sample.txt 100 times
+(open-many) closed all
+(open-many) opened and closed sample.txt 3000 times
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
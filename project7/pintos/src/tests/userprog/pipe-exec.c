@@ -0,0 +1,43 @@
+/* Creates a pipe and runs a child that inherits its read end.
+   The write end is marked close-on-exec, so the child does not
+   get it.  The parent writes more than the pipe can hold while
+   the child reads, so each has to wait for the other.  The child
+   sees end of file once the parent closes the write end.
+   Finally, writing a pipe whose read end is closed must fail. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/pipe.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[PIPE_CHUNK];
+  char child_cmd[128];
+  int fds[2];
+  pid_t child;
+  int ofs, i;
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (cloexec (fds[1], true), "set close-on-exec on write end");
+  snprintf (child_cmd, sizeof child_cmd, "child-pipe %d %d", fds[0], fds[1]);
+  child = exec (child_cmd);
+  if (child == PID_ERROR)
+    fail ("exec \"%s\" failed", child_cmd);
+  close (fds[0]);
+  for (ofs = 0; ofs < PIPE_BYTES; ofs += PIPE_CHUNK)
+    {
+      for (i = 0; i < PIPE_CHUNK; i++)
+        buf[i] = pipe_byte (ofs + i);
+      if (write (fds[1], buf, PIPE_CHUNK) != PIPE_CHUNK)
+        fail ("write to pipe failed");
+    }
+  close (fds[1]);
+  msg ("wait(exec()) = %d", wait (child));
+
+  CHECK (pipe (fds), "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], buf, 1) == -1, "write with read end closed fails");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+(pipe-exec) set close-on-exec on write end
+(child-pipe) begin
+(child-pipe) read 20000 bytes before end of file
+(child-pipe) end
+child-pipe: exit(0)
+(pipe-exec) wait(exec()) = 0
+(pipe-exec) pipe
+(pipe-exec) write with read end closed fails
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
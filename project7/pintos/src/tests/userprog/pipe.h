@@ -0,0 +1,18 @@
+#ifndef TESTS_USERPROG_PIPE_H
+#define TESTS_USERPROG_PIPE_H
+
+/* Bytes the pipe-exec test sends through its pipe, several
+   times what a pipe holds so that the writer has to wait. */
+#define PIPE_BYTES 20000
+
+/* Bytes per read or write. */
+#define PIPE_CHUNK 1000
+
+/* Returns the byte at offset OFS of the data sent. */
+static inline char
+pipe_byte (int ofs) 
+{
+  return ofs % 251;
+}
+
+#endif /* tests/userprog/pipe.h */
@@ -0,0 +1,11 @@
+/* Child process of fork-bench.
+   Exits immediately, so that its cost is that of process
+   creation alone. */
+
+#include <debug.h>
+
+int
+main (int argc UNUSED, char *argv[] UNUSED)
+{
+  return 0;
+}
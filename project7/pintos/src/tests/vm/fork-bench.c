@@ -0,0 +1,53 @@
+/* Measures the average cost of creating a process with fork,
+   compared with exec of a minimal program.  Each iteration
+   creates a child that exits immediately and waits for it, so
+   the time is dominated by process creation: copying the page
+   table with copy-on-write for fork, loading the executable for
+   exec. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ITERATIONS 16
+
+/* Some data so that fork has a nontrivial address space to copy. */
+static char buf[256 * 1024];
+
+void
+test_main (void)
+{
+  uint64_t start, fork_cycles, exec_cycles;
+  size_t i;
+  pid_t pid;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i;
+
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      pid = fork ();
+      if (pid == 0)
+        exit (0);
+      if (pid == PID_ERROR)
+        fail ("fork returned PID_ERROR");
+      if (wait (pid) != 0)
+        fail ("wait for forked child failed");
+    }
+  fork_cycles = (rdtsc () - start) / ITERATIONS;
+
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      pid = exec ("child-null");
+      if (pid == PID_ERROR)
+        fail ("exec returned PID_ERROR");
+      if (wait (pid) != 0)
+        fail ("wait for exec'd child failed");
+    }
+  exec_cycles = (rdtsc () - start) / ITERATIONS;
+
+  msg ("fork: %llu cycles per process", fork_cycles);
+  msg ("exec: %llu cycles per process", exec_cycles);
+}
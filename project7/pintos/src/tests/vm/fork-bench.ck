@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run.
+s/: \d+ cycles/: N cycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(fork-bench) begin
+(fork-bench) fork: N cycles per process
+(fork-bench) exec: N cycles per process
+(fork-bench) end
+EOF
+pass;
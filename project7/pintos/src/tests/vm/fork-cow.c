@@ -0,0 +1,49 @@
+/* Forks a child that overwrites a 2 MB buffer and a stack
+   variable.  The buffer is larger than physical memory, so some
+   of the pages shared by copy-on-write are swapped out while
+   both processes refer to them.  Verifies that the child sees
+   its own modifications and that the parent's copy is
+   unchanged. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int stack_var = 1;
+  pid_t pid;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Child: overwrite everything, then check our copy. */
+      stack_var = 2;
+      for (i = 0; i < SIZE; i++)
+        buf[i] = 0x5a;
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 0x5a)
+          exit (1);
+      exit (stack_var == 2 ? 81 : 1);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork returned PID_ERROR");
+
+  CHECK (wait (pid) == 81, "wait for child");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("parent's byte %zu changed to %d", i, buf[i]);
+  if (stack_var != 1)
+    fail ("parent's stack variable changed");
+  msg ("parent's copy unchanged");
+}
@@ -0,0 +1,62 @@
+/* Maps a file twice, reads the first mapping, and forks.  The
+   child writes to both mappings while the parent waits on a pipe.
+   Mapped pages are shared with the child, whether or not they
+   were resident at fork, so the parent must see both writes in
+   both mappings before either process unmaps them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define ACTUAL2 ((char *) 0x20000000)
+
+void
+test_main (void)
+{
+  int handle, handle2;
+  int ready[2], done[2];
+  pid_t pid;
+  char c = 0;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK ((handle2 = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK (mmap (handle2, ACTUAL2) != MAP_FAILED, "mmap \"sample.txt\" again");
+  CHECK (pipe (ready) && pipe (done), "pipes");
+
+  /* Only the first mapping is resident at fork. */
+  if (memcmp (ACTUAL, sample, strlen (sample)))
+    fail ("read of mapping before fork failed");
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Child: the mapping must be inherited with its contents. */
+      if (memcmp (ACTUAL, sample, strlen (sample)))
+        exit (1);
+      memset (ACTUAL, 'x', 16);
+      memset (ACTUAL2 + 32, 'y', 16);
+      write (ready[1], &c, 1);
+      read (done[0], &c, 1);
+      exit (81);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork returned PID_ERROR");
+
+  CHECK (read (ready[0], &c, 1) == 1, "child wrote mappings");
+  if (memcmp (ACTUAL, "xxxxxxxxxxxxxxxx", 16)
+      || memcmp (ACTUAL2, "xxxxxxxxxxxxxxxx", 16))
+    fail ("child's write to resident page not visible");
+  if (memcmp (ACTUAL + 32, "yyyyyyyyyyyyyyyy", 16)
+      || memcmp (ACTUAL2 + 32, "yyyyyyyyyyyyyyyy", 16))
+    fail ("child's write to page not resident at fork not visible");
+  if (memcmp (ACTUAL + 48, sample + 48, strlen (sample) - 48))
+    fail ("rest of mapping changed");
+  msg ("child's writes visible in parent");
+  write (done[1], &c, 1);
+  CHECK (wait (pid) == 81, "wait for child");
+}
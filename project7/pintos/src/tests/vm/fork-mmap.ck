@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-mmap) begin
+(fork-mmap) open "sample.txt"
+(fork-mmap) mmap "sample.txt"
+(fork-mmap) open "sample.txt" again
+(fork-mmap) mmap "sample.txt" again
+(fork-mmap) pipes
+(fork-mmap) fork
+(fork-mmap) child wrote mappings
+(fork-mmap) child's writes visible in parent
+(fork-mmap) wait for child
+(fork-mmap) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Forks a producer that sends numbers to the parent through a
+   ring buffer in a shared memory segment.  The segment stays
+   shared after fork instead of becoming copy-on-write, so the
+   parent receives every number, in order. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ITEMS 4096              /* Numbers sent. */
+#define RING_SIZE 512           /* Numbers the ring holds. */
+
+/* Ring buffer in the segment. */
+struct ring
+  {
+    volatile unsigned head;     /* Numbers received. */
+    volatile unsigned tail;     /* Numbers sent. */
+    volatile int items[RING_SIZE];
+  };
+
+static struct ring *ring = (struct ring *) 0x10000000;
+
+void
+test_main (void)
+{
+  pid_t pid;
+  int id, i;
+
+  CHECK ((id = shm_create (sizeof *ring)) > 0, "create segment");
+  CHECK (shm_attach (id, ring), "attach segment");
+  CHECK (!shm_attach (id, ring), "attach over attached segment fails");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Child: produce. */
+      for (i = 0; i < ITEMS; i++)
+        {
+          while (ring->tail - ring->head == RING_SIZE)
+            continue;
+          ring->items[ring->tail % RING_SIZE] = i;
+          ring->tail++;
+        }
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork returned PID_ERROR");
+
+  /* Parent: consume. */
+  for (i = 0; i < ITEMS; i++)
+    {
+      while (ring->head == ring->tail)
+        continue;
+      if (ring->items[ring->head % RING_SIZE] != i)
+        fail ("received %d, expected %d",
+              ring->items[ring->head % RING_SIZE], i);
+      ring->head++;
+    }
+  msg ("received %d numbers in order", ITEMS);
+  CHECK (wait (pid) == 0, "wait for producer");
+  CHECK (shm_detach (ring), "detach segment");
+}
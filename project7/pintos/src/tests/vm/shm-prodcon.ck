@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-prodcon) begin
+(shm-prodcon) create segment
+(shm-prodcon) attach segment
+(shm-prodcon) attach over attached segment fails
+(shm-prodcon) received 4096 numbers in order
+(shm-prodcon) wait for producer
+(shm-prodcon) detach segment
+(shm-prodcon) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Shares a 2 MB segment, larger than physical memory, with a
+   forked child that fills it.  Segment pages are evicted to swap
+   while both processes map them.  The parent then checks every
+   byte, faulting the pages back in from the segment's swap
+   slots.  Last, the parent detaches the segment and fills a
+   second one, which has to evict pages that nobody maps, then
+   attaches the first one again and checks it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char *buf = (char *) 0x10000000;
+
+/* Fails unless every byte of BUF holds the pattern. */
+static void
+check_buf (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu is %d, not %d", i, buf[i], (char) (i % 251));
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+  size_t i;
+  int id, other_id;
+
+  CHECK ((id = shm_create (SIZE)) > 0, "create segment");
+  CHECK (shm_attach (id, buf), "attach segment");
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* Child: fill the segment. */
+      for (i = 0; i < SIZE; i++)
+        buf[i] = i % 251;
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork returned PID_ERROR");
+
+  CHECK (wait (pid) == 0, "wait for child");
+  check_buf ();
+  msg ("parent sees child's data");
+
+  CHECK (shm_detach (buf), "detach segment");
+  CHECK ((other_id = shm_create (SIZE)) > 0, "create second segment");
+  CHECK (shm_attach (other_id, buf), "attach second segment");
+  memset (buf, 0xff, SIZE);
+  CHECK (shm_detach (buf), "detach second segment");
+  CHECK (shm_attach (id, buf), "attach first segment again");
+  check_buf ();
+  msg ("first segment kept its data");
+}
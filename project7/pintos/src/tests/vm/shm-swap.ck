@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-swap) begin
+(shm-swap) create segment
+(shm-swap) attach segment
+(shm-swap) wait for child
+(shm-swap) parent sees child's data
+(shm-swap) detach segment
+(shm-swap) create second segment
+(shm-swap) attach second segment
+(shm-swap) detach second segment
+(shm-swap) attach first segment again
+(shm-swap) first segment kept its data
+(shm-swap) end
+EOF
+pass;
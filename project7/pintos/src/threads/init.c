@@ -24,6 +24,7 @@
 #include "threads/thread.h"
 #include "vm/file.h"
 #include "vm/swap.h"
+#include "vm/shm.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -36,6 +37,7 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -54,6 +56,11 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk, -ramdisk-image: Size in sectors of RAM disk to create,
+   and name of block device to fill it from. */
+static size_t ramdisk_sectors;
+static const char *ramdisk_image;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -125,6 +132,7 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  ramdisk_init (ramdisk_sectors, ramdisk_image);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -134,6 +142,7 @@ main (void)
   lock_init(&file_lock);
   lru_list_init();
   swap_init();
+  shm_init();
   /* Run actions specified on kernel command line. */
   run_actions (argv);
 
@@ -256,6 +265,10 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_sectors = atoi (value);
+      else if (!strcmp (name, "-ramdisk-image"))
+        ramdisk_image = value;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -381,6 +394,8 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  -ramdisk=SECTORS   Create RAM disk ram0 with SECTORS sectors.\n"
+          "  -ramdisk-image=BDEV  Fill ram0 with a copy of BDEV.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
@@ -449,10 +449,10 @@ thread_create (const char *name, int priority,
 
   intr_set_level (old_level);
   /* Set Value */
-  t->next_fd = 2;
-  t->file_descriptor = palloc_get_page(0);
-  if(t->file_descriptor == NULL)
-	  return TID_ERROR;
+  t->file_descriptor = NULL;
+  t->fd_map = NULL;
+  t->cloexec_map = NULL;
+  t->fd_cnt = 0;
   t->childelem.next = NULL;
   t->childelem.prev = NULL;
   t->parent_thread = thread_current();
@@ -775,6 +775,7 @@ init_thread (struct thread *t, const char *name, int priority)
   /* init mmap_file_list */
   list_init(&(t->mmap_list));
   t->mapid = 0;
+  list_init(&(t->shm_list));
   /* init mlfq value */
   t->nice = NICE_DEFAULT;
   t->recent_cpu = RECENT_CPU_DEFAULT;
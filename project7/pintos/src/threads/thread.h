@@ -108,8 +108,10 @@ struct thread
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
     /* VALUE */
-	struct file **file_descriptor;
-	int next_fd;
+	struct file **file_descriptor;	/* fd table, NULL until first open */
+	struct bitmap *fd_map;		/* used slots of fd table */
+	struct bitmap *cloexec_map;	/* fds closed on exec */
+	int fd_cnt;			/* size of fd table */
 	bool load_success;
 	bool process_exit;
 	int process_exit_status;
@@ -131,6 +133,8 @@ struct thread
 	/* mmap_file list */
 	struct list mmap_list;
 	int mapid;
+	/* attached shared memory segments */
+	struct list shm_list;
   };
 int64_t next_tick_to_awake;
 
@@ -152,28 +152,46 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* loaded physical memory */
-  check_address(fault_addr, f->esp);
+  /* loaded physical memory. kernel's esp is not user stack pointer,
+     so stack is not expanded on kernel fault */
+  if(user == true)
+	check_address(fault_addr, f->esp);
+  vme = find_vme(fault_addr);
 	if(not_present==false)
-		exit(-1);
-
-  	vme = find_vme(fault_addr);
-  	if(vme != NULL)
+	{
+		/* writing to copy-on-write page shared after fork */
+		if(write == true && vme != NULL && vme->writable == true)
+			load = handle_cow_fault(vme);
+		if(load == true)
+		{
+			vme->pinned = false;
+			return;
+		}
+	}
+  	else if(vme != NULL)
   	{
-	  	load = handle_mm_fault(vme);
+		/* writing to demand-zero page allocates it directly */
+		if(write == true && vme->type == VM_ZERO)
+			load = handle_zero_fault(vme, true);
+		else
+	  		load = handle_mm_fault(vme);
 	  	if(vme->is_loaded == true)
 	  	{
 			vme->pinned = false;
 			load = true;
 	  	}
 	}
-//	else if(fault_addr >= f->esp - STACK_HEURISTIC)
-//	{
-//		load = expand_stack(fault_addr);
-//		if(load == false)
-//			exit(-1);
-//	}
- 
+	/* fault in copy_from_user() or copy_to_user().
+	   return -1 in eax to the instruction after faulting access */
+	if(load == false && user == false && is_user_vaddr(fault_addr))
+	{
+		f->eip = (void (*) (void)) f->eax;
+		f->eax = 0xffffffff;
+		return;
+	}
+	if(load == false && not_present == false)
+		exit(-1);
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -1,4 +1,5 @@
 #include "userprog/process.h"
+#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
@@ -21,7 +22,9 @@
 #include "threads/vaddr.h"
 #include "vm/file.h"
 #include "vm/swap.h"
+#include "vm/shm.h"
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool install_page (void *upage, void *kpage, bool writable);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 /* Starts a new thread running a user program loaded from
@@ -59,53 +62,242 @@ process_execute (const char *file_name)
   
   return tid;
 }
-/* add file to file descriptor */
-int
-process_add_file(struct file *f)
+/* argument of start_fork. lives on parent's stack until child is copied */
+struct fork_aux
+{
+	struct thread *parent;             // forking process
+	struct intr_frame if_;             // parent's user context at fork
+};
+
+/* Clone the current process. the child shares parent's pages by
+   copy-on-write and returns 0 from fork. Returns the child's thread id,
+   or TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (struct intr_frame *f)
 {
-	struct file **fd = NULL;
-	int nextFd;
+  struct fork_aux aux;
+  struct thread *child_process;
+  tid_t tid;
 
-	fd = thread_current()->file_descriptor;
-	nextFd = thread_current()->next_fd;
+  aux.parent = thread_current();
+  memcpy(&aux.if_, f, sizeof aux.if_);
+  tid = thread_create (thread_current()->name, thread_get_priority(), start_fork, &aux);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  /* wait until child copies the address space */
+  child_process = get_child_process(tid);
+  sema_down(&(child_process->load_semaphore));
+  if(child_process->load_success == false)
+	  return TID_ERROR;
+  return tid;
+}
 
-	if(fd != NULL)
+/* grow fd table of T so that FD fits in it.
+   fd 0 and 1 are reserved for console, but dup2 can point them
+   at a file or pipe */
+static bool
+fd_table_grow(struct thread *t, int fd)
+{
+	struct file **table;
+	struct bitmap *map, *cloexec;
+	int cnt = t->fd_cnt == 0 ? FD_INIT : t->fd_cnt;
+	int i;
+
+	if(fd < t->fd_cnt)
+		return true;
+	if(fd < 0 || fd >= FD_MAX)
+		return false;
+	while(cnt <= fd)
+		cnt *= 2;
+	table = malloc(cnt * sizeof *table);
+	map = bitmap_create(cnt);
+	cloexec = bitmap_create(cnt);
+	if(table == NULL || map == NULL || cloexec == NULL)
 	{
-		fd[nextFd] = f;
-		thread_current()->next_fd = thread_current()->next_fd+1;
-		return nextFd;
+		free(table);
+		if(map != NULL)
+			bitmap_destroy(map);
+		if(cloexec != NULL)
+			bitmap_destroy(cloexec);
+		return false;
 	}
-	else
+	for(i=0; i<cnt; i++)
+		table[i] = i < t->fd_cnt ? t->file_descriptor[i] : NULL;
+	bitmap_set_multiple(map, 0, 2, true);
+	for(i=2; i<t->fd_cnt; i++)
+		bitmap_set(map, i, bitmap_test(t->fd_map, i));
+	for(i=0; i<t->fd_cnt; i++)
+		bitmap_set(cloexec, i, bitmap_test(t->cloexec_map, i));
+
+	free(t->file_descriptor);
+	if(t->fd_map != NULL)
+		bitmap_destroy(t->fd_map);
+	if(t->cloexec_map != NULL)
+		bitmap_destroy(t->cloexec_map);
+	t->file_descriptor = table;
+	t->fd_map = map;
+	t->cloexec_map = cloexec;
+	t->fd_cnt = cnt;
+	return true;
+}
+
+/* duplicate parent's open files to current thread, on fork and
+   on exec. exec leaves out fds marked close-on-exec */
+static bool
+copy_files(struct thread *parent, bool exec)
+{
+	struct thread *cur = thread_current();
+	struct file *parent_file;
+	int i, j;
+
+	if(parent->fd_cnt == 0)
+		return true;
+	if(!fd_table_grow(cur, parent->fd_cnt - 1))
+		return false;
+	for(i=0; i<parent->fd_cnt; i++)
 	{
-		return -1;
+		parent_file = parent->file_descriptor[i];
+		if(parent_file == NULL)
+			continue;
+		if(bitmap_test(parent->cloexec_map, i))
+		{
+			if(exec)
+				continue;
+			bitmap_mark(cur->cloexec_map, i);
+		}
+		/* keep fds duplicated with dup2 shared in child */
+		for(j=0; j<i; j++)
+			if(parent->file_descriptor[j] == parent_file
+			   && cur->file_descriptor[j] != NULL)
+				break;
+		if(j < i)
+			cur->file_descriptor[i] = file_dup(cur->file_descriptor[j]);
+		else
+		{
+			cur->file_descriptor[i] = file_reopen(parent_file);
+			if(cur->file_descriptor[i] == NULL)
+				return false;
+			file_seek(cur->file_descriptor[i], file_tell(parent_file));
+		}
+		bitmap_mark(cur->fd_map, i);
 	}
+	return true;
 }
-/* get struct file  */
-struct file *process_get_file(int fd)
+
+/* A thread function that copies the parent's address space and open
+   files and returns to user mode from fork with 0. */
+static void
+start_fork (void *aux_)
 {
-	struct file *pReturn;
-	if(fd < thread_current()->next_fd)
+  struct fork_aux *aux = aux_;
+  struct thread *cur = thread_current ();
+  struct thread *parent = aux->parent;
+  struct intr_frame if_;
+  bool success = false;
+
+  memcpy(&if_, &aux->if_, sizeof if_);
+  vm_init(&cur->vm);
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir != NULL)
+    {
+      process_activate ();
+      success = vm_copy(parent) && mmap_copy(parent) && shm_copy(parent)
+                && copy_files(parent, false);
+    }
+
+  /* parent may return from fork after sema up, aux is no longer valid */
+  cur->load_success = success;
+  sema_up(&(cur->load_semaphore));
+  if (!success)
+    {
+      cur->process_exit_status = -1;
+      thread_exit ();
+    }
+
+  /* child returns 0 from fork */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* add file to lowest free file descriptor, growing the table
+   when it is full. return -1 if no descriptor is left */
+int
+process_add_file(struct file *f)
+{
+	struct thread *cur = thread_current();
+	size_t fd = BITMAP_ERROR;
+
+	if(cur->fd_map != NULL)
+		fd = bitmap_scan_and_flip(cur->fd_map, 0, 1, false);
+	if(fd == BITMAP_ERROR)
 	{
-		pReturn = thread_current()->file_descriptor[fd];
-		return pReturn;
+		fd = cur->fd_cnt < 2 ? 2 : cur->fd_cnt;
+		if(!fd_table_grow(cur, fd))
+			return -1;
+		bitmap_mark(cur->fd_map, fd);
 	}
-	else
-	{
+	cur->file_descriptor[fd] = f;
+	return fd;
+}
+/* get struct file  */
+struct file *process_get_file(int fd)
+{
+	struct thread *cur = thread_current();
+
+	if(fd < 0 || fd >= cur->fd_cnt)
 		return NULL;
-	}
+	return cur->file_descriptor[fd];
 }
 /* close file function */
 void
 process_close_file(int fd)
 {
+	struct thread *cur = thread_current();
 	struct file *delete_file;
+
 	delete_file = process_get_file(fd);
 	if(delete_file != NULL)
 	{
 		file_close(delete_file);
-		thread_current()->file_descriptor[fd] = NULL;
+		cur->file_descriptor[fd] = NULL;
+		bitmap_reset(cur->cloexec_map, fd);
+		/* closed fd 0 or 1 goes back to console */
+		if(fd >= 2)
+			bitmap_reset(cur->fd_map, fd);
 	}
 }
+/* make NEWFD refer to the same open file as OLDFD, closing NEWFD
+   first if it is open. return NEWFD, or -1 on error */
+int
+process_dup2(int oldfd, int newfd)
+{
+	struct thread *cur = thread_current();
+	struct file *old_file = process_get_file(oldfd);
+
+	if(old_file == NULL || newfd < 0)
+		return -1;
+	if(oldfd == newfd)
+		return newfd;
+	if(!fd_table_grow(cur, newfd))
+		return -1;
+	process_close_file(newfd);
+	cur->file_descriptor[newfd] = file_dup(old_file);
+	bitmap_mark(cur->fd_map, newfd);
+	return newfd;
+}
+/* close FD on exec if ON is true, keep it open otherwise.
+   return false if FD is not open */
+bool
+process_set_cloexec(int fd, bool on)
+{
+	struct thread *cur = thread_current();
+
+	if(process_get_file(fd) == NULL)
+		return false;
+	bitmap_set(cur->cloexec_map, fd, on);
+	return true;
+}
 /* Push arguments into user stack */
 void argument_stack(char **parse,int count,void **esp)
 {
@@ -187,17 +379,109 @@ remove_child_process(struct thread *cp)
 	}
 }
 
-/* handle page fault */
-bool handle_mm_fault(struct vm_entry *vme)
+/* map read-only code page shared with other processes running the same
+   executable, or page of a file mapping shared writable with every
+   process mapping the file. if the page is not in page cache, load it
+   and insert it */
+static bool
+handle_shared_fault(struct vm_entry *vme)
 {
-	/* get a physical memory */
-	struct page *new_page = alloc_page(PAL_USER);
-	new_page->vme = vme;
+	struct inode *inode = file_get_inode(vme->file);
+	struct page *page;
+
+	/* try to find page in page cache */
+	page = page_cache_lookup(inode, vme->offset, vme->read_bytes, vme);
+	if(page == NULL)
+	{
+		page = alloc_page(PAL_USER);
+		if(page == NULL)
+			return false;
+		if(load_file(page->kaddr, vme) == false)
+		{
+			free_page(page->kaddr);
+			return false;
+		}
+		page = page_cache_insert(page, inode, vme->offset, vme->read_bytes, vme);
+	}
+	/* set a page table. if fail, drop the reference to the page */
+	if(install_page(vme->vaddr, page->kaddr, vme->type == VM_FILE && vme->writable) == false)
+	{
+		del_vme_from_page(vme);
+		return false;
+	}
+	vme->is_loaded = true;
+	return true;
+}
+
+/* map page of shared memory segment, which every attached process
+   maps writable */
+static bool
+handle_shm_fault(struct vm_entry *vme)
+{
+	struct page *page = shm_get_page(vme);
+
+	if(page == NULL)
+		return false;
+	if(install_page(vme->vaddr, page->kaddr, true) == false)
+	{
+		del_vme_from_page(vme);
+		return false;
+	}
+	vme->is_loaded = true;
+	return true;
+}
+
+/* handle fault on demand-zero page. reading maps the shared zero page
+   read-only, the first write allocates a private zeroed page */
+bool handle_zero_fault(struct vm_entry *vme, bool write)
+{
+	struct thread *cur = thread_current();
+	struct page *new_page;
+
 	vme->pinned = true;
-	if(vme->is_loaded == true){       // if vme is already loaded, return false
-		free_page(new_page);
+	if(write == false || vme->writable == false)
+	{
+		if(vme->is_loaded == true)
+			return false;
+		if(install_page(vme->vaddr, zero_page, false) == false)
+			return false;
+		vme->is_loaded = true;
+		return true;
+	}
+	new_page = alloc_page(PAL_USER | PAL_ZERO);
+	if(new_page == NULL)
+		return false;
+	/* drop mapping of the shared zero page */
+	if(vme->is_loaded == true)
+		pagedir_clear_page(cur->pagedir, vme->vaddr);
+	if(install_page(vme->vaddr, new_page->kaddr, true) == false)
+	{
+		free_page(new_page->kaddr);
 		return false;
 	}
+	vme->type = VM_ANON;
+	add_vme_to_page(new_page, vme);
+	vme->is_loaded = true;
+	return true;
+}
+
+/* handle page fault */
+bool handle_mm_fault(struct vm_entry *vme)
+{
+	struct page *new_page;
+	if(vme->is_loaded == true)        // if vme is already loaded, return false
+		return false;
+	vme->pinned = true;
+	/* demand-zero page maps the shared zero page until written */
+	if(vme->type == VM_ZERO)
+		return handle_zero_fault(vme, false);
+	/* read-only code pages and mmap'd pages are shared through page cache */
+	if((vme->type == VM_BIN && vme->writable == false) || vme->type == VM_FILE)
+		return handle_shared_fault(vme);
+	if(vme->type == VM_SHM)
+		return handle_shm_fault(vme);
+	/* get a physical memory */
+	new_page = alloc_page(PAL_USER);
 	if(new_page == NULL)
 		return false;
 	switch(vme->type)                
@@ -211,18 +495,11 @@ bool handle_mm_fault(struct vm_entry *vme)
 				return false;
 			}
 			break;
-		/* if vm_entry type is VM_FILE */
-		case VM_FILE:
-			if(load_file(new_page->kaddr,vme) == false)
-			{
-				free_page(new_page->kaddr);
-				return false;
-			}
-			break;
 		case VM_ANON:
 			swap_in(vme->swap_slot, new_page->kaddr);
 			break;
 		default:
+			free_page(new_page->kaddr);
 			return false;
 	}
 	/* set a page table. if fail, free the physical memory  */
@@ -231,54 +508,75 @@ bool handle_mm_fault(struct vm_entry *vme)
 		free_page(new_page->kaddr);
 		return false;
 	}
+	add_vme_to_page(new_page, vme);
 	/* set vme->is_loaded is true */
 	vme->is_loaded = true;
 	return true;
 }
+/* handle write fault on page shared by copy-on-write after fork */
+bool handle_cow_fault(struct vm_entry *vme)
+{
+	struct thread *cur = thread_current();
+	struct page *old_page;
+	struct page *new_page;
+	bool dirty;
+
+	vme->pinned = true;
+	/* first write to demand-zero page */
+	if(vme->type == VM_ZERO)
+		return handle_zero_fault(vme, true);
+	old_page = vme->page;
+	/* page was evicted meanwhile, next access faults it in */
+	if(old_page == NULL)
+		return true;
+	/* if no other process shares the page, just make it writable */
+	if(old_page->ref_cnt == 1)
+	{
+		pagedir_set_writable(cur->pagedir, vme->vaddr, true);
+		return true;
+	}
+	/* copy the page to private physical memory */
+	new_page = alloc_page(PAL_USER);
+	if(new_page == NULL)
+		return false;
+	memcpy(new_page->kaddr, old_page->kaddr, PGSIZE);
+	dirty = pagedir_is_dirty(cur->pagedir, vme->vaddr);
+	del_vme_from_page(vme);
+	if(install_page(vme->vaddr, new_page->kaddr, true) == false)
+	{
+		free_page(new_page->kaddr);
+		return false;
+	}
+	pagedir_set_dirty(cur->pagedir, vme->vaddr, dirty);
+	add_vme_to_page(new_page, vme);
+	vme->is_loaded = true;
+	return true;
+}
+
 bool expand_stack(void *addr)
 {
 	struct vm_entry *vme;
-	struct page *stack_page;
 
 	/* check stack is fulled */
 	if((size_t)(PHYS_BASE - pg_round_down(addr)) > MAX_STACK_SIZE)
 		return false;
 
-	/* allocate vm_entry and initialize the vm_entry */
+	/* allocate vm_entry and initialize the vm_entry.
+	   stack page is demand-zero, physical memory is allocated on fault */
 	vme = malloc(sizeof(struct vm_entry));
 	if(vme == NULL)
 		return false;
 	vme->vaddr     = pg_round_down(addr);
-	vme->type      = VM_ANON;
-	vme->is_loaded = true;
+	vme->type      = VM_ZERO;
+	vme->is_loaded = false;
 	vme->writable  = true;
-	vme->pinned    = true;
-	/* allocate page and initialize the page's vm_entry */
-	stack_page = alloc_page(PAL_USER);
-	if(stack_page == NULL)
-	{
-		free(vme);
-		return false;
-	}
-	stack_page->vme = vme;
-	/* setting the page table. */
-	if(install_page(vme->vaddr, stack_page->kaddr, vme->writable) == false)
-	{
-		free_page(stack_page);
-		free(vme);
-		return false;
-	}
+	vme->pinned    = false;
 	/* insert vm_entry to hash_table */
 	if(insert_vme(&thread_current()->vm, vme) == false)
 	{
-		free_page(stack_page);
 		free(vme);
 		return false;
 	}
-	if(intr_context())
-	{
-		vme->pinned = false;
-	}
 	return true;
 }
 
@@ -311,7 +609,8 @@ start_process (void *file_name_)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (parse[0], &if_.eip, &if_.esp);
+  success = load (parse[0], &if_.eip, &if_.esp)
+            && copy_files (thread_current ()->parent_thread, true);
     
   /* load finished sema up */
   thread_current()->load_success=success;
@@ -376,12 +675,21 @@ process_exit (void)
 
   /* close file and file descriptor delete */
   int i;
-  for(i=2; i<cur->next_fd; i++)
+  for(i=0; i<cur->fd_cnt; i++)
 	  process_close_file(i);
-  palloc_free_page(cur->file_descriptor);
+  free(cur->file_descriptor);
+  if(cur->fd_map != NULL)
+	  bitmap_destroy(cur->fd_map);
+  if(cur->cloexec_map != NULL)
+	  bitmap_destroy(cur->cloexec_map);
+  cur->file_descriptor = NULL;
+  cur->fd_map = NULL;
+  cur->cloexec_map = NULL;
+  cur->fd_cnt = 0;
   /* unmap the all process's mapped file and 
      destroy vm_entry hash */
   munmap(CLOSE_ALL);
+  shm_exit();
   vm_destroy(&cur->vm);
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -696,6 +1004,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	  vme->is_loaded  = false;
 	  vme->type       = VM_BIN;
 	  vme->pinned     = false;
+	  /* page with nothing to read from file is demand-zero */
+	  if(page_read_bytes == 0)
+		  vme->type   = VM_ZERO;
 
 	  /* added vm_entry to hash */
 	  if(insert_vme(&thread_current()->vm, vme) == false )
@@ -730,9 +1041,11 @@ setup_stack (void **esp)
         free_page (kpage->kaddr);
     }
  
+  if(success == false)
+	  return false;
   vme = malloc(sizeof(struct vm_entry));
   if(vme == NULL){
-	  free_page(kpage);
+	  free_page(kpage->kaddr);
 	  return false;
   }
   /* initialize vm_entry */
@@ -741,9 +1054,10 @@ setup_stack (void **esp)
   vme->writable  = true;
   vme->type      = VM_ANON;
   vme->pinned    = true;
-  kpage->vme     = vme;
   /* insert vm_entry. if fail, return false*/
   success = insert_vme(&thread_current()->vm, vme);
+  if(success)
+	  add_vme_to_page(kpage, vme);
 
   return success;
 }
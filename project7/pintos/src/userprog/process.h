@@ -4,9 +4,11 @@
 #define MAX_STACK_SIZE (1 << 23)
 
 #include "threads/thread.h"
+#include "threads/interrupt.h"
 #include "vm/page.h"
 
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *f);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -15,10 +17,17 @@ bool setup_stack (void **esp);
 void argument_stack(char **parse, int count, void **esp);
 struct thread *get_child_process(int pid);
 void remove_child_process(struct thread *cp);
+/* file descriptor table starts with FD_INIT slots and doubles up to FD_MAX */
+#define FD_INIT 16
+#define FD_MAX 1024
 int process_add_file(struct file *f);
 struct file *process_get_file(int fd);
 void process_close_file(int fd);
+int process_dup2(int oldfd, int newfd);
+bool process_set_cloexec(int fd, bool on);
 void process_exit(void);
 bool handle_mm_fault(struct vm_entry *vme);
+bool handle_cow_fault(struct vm_entry *vme);
+bool handle_zero_fault(struct vm_entry *vme, bool write);
 bool expand_stack(void *addr);
 #endif /* userprog/process.h */
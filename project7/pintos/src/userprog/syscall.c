@@ -10,8 +10,14 @@
 #include <userprog/process.h>
 #include <devices/input.h>
 #include "vm/page.h"
+#include "vm/file.h"
+#include "vm/shm.h"
+#include "userprog/pagedir.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
-static void syscall_handler (struct intr_frame *);
+static int get_user (const uint8_t *usrc);
+static bool put_user (uint8_t *udst, uint8_t byte);
 
 void
 syscall_init (void) 
@@ -19,16 +25,18 @@ syscall_init (void)
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
-static void
+/* also called by sysenter_entry in sysenter.S */
+void
 syscall_handler (struct intr_frame *f ) 
 {
   /* VALUE */	
   int syscall_num;
   int arg[5];
   void *esp = f->esp;
+  char *str;
   /* VALUE */
-  check_address(esp, f->esp);
-  syscall_num = *(int *)esp;
+  if(copy_from_user(&syscall_num, esp, sizeof syscall_num) == false)
+	  exit(-1);
   switch(syscall_num)
   {
 	  case SYS_HALT:
@@ -40,9 +48,9 @@ syscall_handler (struct intr_frame *f )
 		  break;
 	  case SYS_EXEC:
 		  get_argument(esp,arg,1);
-		  check_valid_string((const void *)arg[0], f->esp);
-		  f->eax = exec((const char *)arg[0]);
-		  unpin_string((void *)arg[0]);
+		  str = copy_in_string((const char *)arg[0]);
+		  f->eax = exec(str);
+		  palloc_free_page(str);
 		  break;
 	  case SYS_WAIT:
 		  get_argument(esp,arg,1);
@@ -50,20 +58,21 @@ syscall_handler (struct intr_frame *f )
 		  break;
 	  case SYS_CREATE:
 		  get_argument(esp,arg,2);
-		  check_valid_string((const void *)arg[0], f->esp);
-		  f->eax = create((const char *)arg[0],(unsigned)arg[1]);
-		  unpin_string((void *)arg[0]);
+		  str = copy_in_string((const char *)arg[0]);
+		  f->eax = create(str,(unsigned)arg[1]);
+		  palloc_free_page(str);
 		  break;
 	  case SYS_REMOVE:
 		  get_argument(esp,arg,1);
-		  check_valid_string((const void *)arg[0], f->esp);
-		  f->eax=remove((const char *)arg[0]);
+		  str = copy_in_string((const char *)arg[0]);
+		  f->eax=remove(str);
+		  palloc_free_page(str);
 		  break;
 	  case SYS_OPEN:
 		  get_argument(esp,arg,1);
-		  check_valid_string((const void *)arg[0], f->esp);
-		  f->eax = open((const char *)arg[0]);
-		  unpin_string((void *)arg[0]);
+		  str = copy_in_string((const char *)arg[0]);
+		  f->eax = open(str);
+		  palloc_free_page(str);
 		  break;
 	  case SYS_FILESIZE:
 		  get_argument(esp,arg,1);
@@ -71,15 +80,15 @@ syscall_handler (struct intr_frame *f )
 		  break;
 	  case SYS_READ:
 		  get_argument(esp,arg,3);
-		  check_valid_buffer((void *)arg[1], (unsigned)arg[2], f->esp, true);
+		  pin_user_buffer((void *)arg[1], (unsigned)arg[2], f->esp, true);
 		  f->eax = read(arg[0],(void *)arg[1],(unsigned)arg[2]);
-		  unpin_buffer((void *)arg[1], (unsigned) arg[2]);
+		  unpin_user_buffer((void *)arg[1], (unsigned) arg[2]);
 		  break;
 	  case SYS_WRITE:
 		  get_argument(esp,arg,3);
-		  check_valid_buffer((void *)arg[1], (unsigned)arg[2], f->esp, false);
+		  pin_user_buffer((void *)arg[1], (unsigned)arg[2], f->esp, false);
 		  f->eax = write(arg[0],(void *)arg[1],(unsigned)arg[2]);
-		  unpin_buffer((void *)arg[1], (unsigned)arg[2]);
+		  unpin_user_buffer((void *)arg[1], (unsigned)arg[2]);
 		  break;
 	  case SYS_SEEK:
 		  get_argument(esp,arg,2);
@@ -101,8 +110,37 @@ syscall_handler (struct intr_frame *f )
 		  get_argument(esp,arg,1);
 		  munmap(arg[0]);
 		  break;
+	  case SYS_FORK:
+		  f->eax = process_fork(f);
+		  break;
+	  case SYS_DUP2:
+		  get_argument(esp,arg,2);
+		  f->eax = process_dup2(arg[0],arg[1]);
+		  break;
+	  case SYS_PIPE:
+		  get_argument(esp,arg,1);
+		  f->eax = pipe((int *)arg[0]);
+		  break;
+	  case SYS_SHM_CREATE:
+		  get_argument(esp,arg,1);
+		  f->eax = shm_create((unsigned)arg[0]);
+		  break;
+	  case SYS_SHM_ATTACH:
+		  get_argument(esp,arg,2);
+		  f->eax = shm_attach(arg[0],(void *)arg[1]);
+		  break;
+	  case SYS_SHM_DETACH:
+		  get_argument(esp,arg,1);
+		  f->eax = shm_detach((void *)arg[0]);
+		  break;
+	  case SYS_CLOEXEC:
+		  get_argument(esp,arg,2);
+		  f->eax = process_set_cloexec(arg[0],arg[1]);
+		  break;
+	  case SYS_NULL:
+		  f->eax = 0;
+		  break;
   }
-  unpin_ptr(f->esp);
 }
 /* chack_address function */
 void
@@ -133,55 +171,152 @@ check_address(void *addr, void *esp)
 		exit(-1);
 	}
 }
-void check_valid_buffer(void *buffer, unsigned size, void *esp, bool to_write)
+/* read a byte at user address usrc.
+   return the byte, or -1 if a page fault occurred */
+static int
+get_user (const uint8_t *usrc)
 {
-	struct vm_entry *vme;
-	unsigned i;
-	char *check_buffer = (char *)buffer;
-	/* check buffer */
+	int result;
+	asm ("movl $1f, %0; movzbl %1, %0; 1:"
+	     : "=&a" (result) : "m" (*usrc));
+	return result;
+}
+/* write byte to user address udst.
+   return false if a page fault occurred */
+static bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+	int error_code;
+	asm ("movl $1f, %0; movb %b2, %1; 1:"
+	     : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+	return error_code != -1;
+}
+/* copy size bytes from user address usrc to kernel buffer dst.
+   return false if user memory is not accessible */
+bool copy_from_user(void *dst, const void *usrc, size_t size)
+{
+	uint8_t *dst_byte = dst;
+	const uint8_t *src_byte = usrc;
+	int byte;
+	size_t i;
+
+	if(size == 0)
+		return true;
+	if(!is_user_vaddr(src_byte + size - 1) || src_byte + size - 1 < src_byte)
+		return false;
 	for(i=0; i<size; i++)
 	{
-		check_address((void *)check_buffer, esp);
-		vme = find_vme((void *)check_buffer);
-		if(vme != NULL)
+		byte = get_user(src_byte + i);
+		if(byte == -1)
+			return false;
+		dst_byte[i] = byte;
+	}
+	return true;
+}
+/* copy size bytes from kernel buffer src to user address udst.
+   return false if user memory is not writable */
+bool copy_to_user(void *udst, const void *src, size_t size)
+{
+	uint8_t *dst_byte = udst;
+	const uint8_t *src_byte = src;
+	size_t i;
+
+	if(size == 0)
+		return true;
+	if(!is_user_vaddr(dst_byte + size - 1) || dst_byte + size - 1 < dst_byte)
+		return false;
+	for(i=0; i<size; i++)
+	{
+		if(put_user(dst_byte + i, src_byte[i]) == false)
+			return false;
+	}
+	return true;
+}
+/* copy user string into a new kernel page. caller frees the page
+   with palloc_free_page. exit the process if string is invalid */
+char *copy_in_string(const char *ustr)
+{
+	char *kstr;
+	int byte;
+	size_t i;
+
+	kstr = palloc_get_page(0);
+	if(kstr == NULL)
+		exit(-1);
+	for(i=0; i<PGSIZE; i++)
+	{
+		if(!is_user_vaddr(ustr + i) || (byte = get_user((const uint8_t *)ustr + i)) == -1)
+			break;
+		kstr[i] = byte;
+		if(byte == 0)
+			return kstr;
+	}
+	/* fault or string is longer than a page */
+	palloc_free_page(kstr);
+	exit(-1);
+	return NULL;
+}
+/* validate user buffer a page at a time, load every page of it and
+   pin them so they are not evicted while kernel accesses the buffer */
+void pin_user_buffer(void *buffer, unsigned size, void *esp, bool to_write)
+{
+	struct vm_entry *vme;
+	uint32_t *pd = thread_current()->pagedir;
+	void *end = buffer + size;
+	void *upage;
+	void *addr;
+	bool load;
+
+	if(end < buffer)
+		exit(-1);
+	for(upage = pg_round_down(buffer); upage < end; upage += PGSIZE)
+	{
+		/* buffer may start in the middle of first page */
+		addr = upage < buffer ? buffer : upage;
+		check_address(addr, esp);
+		vme = find_vme(addr);
+		if(vme == NULL)
+			exit(-1);
+		/* if to_write is true, vm_entry must writable */
+		if(to_write == true && vme->writable == false)
+			exit(-1);
+		if(pin_page(vme) == false)
 		{
-			/* if to_write is true, vm_entry must writable.
-			   so if to_write is true but vm_entry is not writable
-			   exit the process. */
-			if(to_write == true)
-			{
-				if(vme->writable == false)
-					exit(-1);
-			}
+			if(to_write == true && vme->type == VM_ZERO)
+				load = handle_zero_fault(vme, true);
+			else
+				load = handle_mm_fault(vme);
+			if(load == false)
+				exit(-1);
+		}
+		/* copy the copy-on-write page before kernel writes to it */
+		if(to_write == true && pagedir_is_writable(pd, vme->vaddr) == false)
+		{
+			if(handle_cow_fault(vme) == false)
+				exit(-1);
 		}
-		check_buffer++;
 	}
 }
-void check_valid_string(const void *str, void *esp)
+/* unpin pages pinned by pin_user_buffer */
+void unpin_user_buffer(void *buffer, unsigned size)
 {
-	char *check_str = (char *)str;
-	check_address((void *)check_str,esp);
-	/* check the all string's address */
-	while(*check_str != 0)
+	struct vm_entry *vme;
+	void *end = buffer + size;
+	void *upage;
+
+	for(upage = pg_round_down(buffer); upage < end; upage += PGSIZE)
 	{
-		check_str += 1;
-		check_address(check_str, esp);
+		vme = find_vme(upage);
+		if(vme != NULL)
+			vme->pinned = false;
 	}
 }
 /* get_argument function */
 void
 get_argument(void *esp, int *arg, int count)
 {
-	int i;
-	void *stack_pointer=esp+4;
-	if(count > 0)
-	{
-		for(i=0; i<count; i++){
-			check_address(stack_pointer, esp);
-			arg[i] = *(int *)stack_pointer;
-			stack_pointer = stack_pointer + 4;
-		}
-	}
+	if(copy_from_user(arg, esp + 4, count * sizeof(int)) == false)
+		exit(-1);
 }
 
 /* exit pintos */
@@ -255,6 +390,8 @@ open(const char *file)
 	if(new_file != NULL)
 	{
 		fd = process_add_file(new_file);
+		if(fd == -1)
+			file_close(new_file);
 		return fd;
 	}
 	else
@@ -284,12 +421,16 @@ int
 read(int fd, void *buffer, unsigned size)
 {
 	int read_size = 0;
-	struct file *current_file;
+	struct file *current_file = process_get_file(fd);
 	char *read_buffer = (char *)buffer;
-    
+
+	/* pipe may wait for its writer, which must be able to take file_lock */
+	if(current_file != NULL && file_is_pipe(current_file))
+		return file_read(current_file, buffer, size);
+
 	lock_acquire(&file_lock);
 
-	if(fd == 0)              /* stdin */
+	if(fd == 0 && current_file == NULL)              /* stdin */
 	{
 		read_buffer[read_size]=input_getc();
 		while(read_buffer[read_size] != '\n' && read_size < size)
@@ -299,13 +440,9 @@ read(int fd, void *buffer, unsigned size)
 		}
 		read_buffer[read_size]='\0';
 	}
-	else
+	else if(current_file != NULL)
 	{
-		current_file = process_get_file(fd);
-		if(current_file != NULL)
-		{
-			read_size = file_read(current_file,buffer,size);
-		}
+		read_size = file_read(current_file,buffer,size);
 	}
 	lock_release(&file_lock);
 	return read_size;
@@ -315,19 +452,20 @@ int
 write(int fd, void *buffer, unsigned size)
 {
 	int write_size = 0;
-	struct file *current_file;
+	struct file *current_file = process_get_file(fd);
 
-	if(fd == 1)                    /* stdout */
+	if(fd == 1 && current_file == NULL)                    /* stdout */
 	{ 
 		putbuf((const char *)buffer,size);
 		write_size = size;
 	}
-	else
+	/* pipe may wait for its reader, so file_lock is not held */
+	else if(current_file != NULL && file_is_pipe(current_file))
+		write_size = file_write(current_file,(const void *)buffer,size);
+	else if(current_file != NULL)
 	{
 		lock_acquire(&file_lock);
-		current_file = process_get_file(fd);
-		if(current_file != NULL)
-			write_size = file_write(current_file,(const void *)buffer,size);
+		write_size = file_write(current_file,(const void *)buffer,size);
 		lock_release(&file_lock);
 	}
 	return write_size;
@@ -361,48 +499,41 @@ close(int fd)
 	struct file *current_file;
 	current_file = process_get_file(fd);
 	if(current_file != NULL)
-	{
-		file_close(current_file);
-		thread_current()->file_descriptor[fd]=NULL;
-	}
+		process_close_file(fd);
 }
 
-int mmap(int fd, void *addr)
-{
-	return file_mmap(fd,(void *)addr);
-}
-
-void munmap(int mapping)
+/* create a pipe. store fd of its read end to fds[0] and fd of
+   its write end to fds[1] */
+bool
+pipe(int *fds)
 {
-	file_munmap(mapping);
-}
+	struct file *read_end, *write_end;
+	int kfds[2];
 
-void unpin_ptr(void *vaddr)
-{
-	struct vm_entry *vme  = find_vme(vaddr);
-	if(vme != NULL)
+	if(!file_open_pipe(&read_end, &write_end))
+		return false;
+	kfds[0] = process_add_file(read_end);
+	kfds[1] = kfds[0] == -1 ? -1 : process_add_file(write_end);
+	if(kfds[1] == -1)
 	{
-		vme->pinned = false;
+		if(kfds[0] == -1)
+			file_close(read_end);
+		else
+			process_close_file(kfds[0]);
+		file_close(write_end);
+		return false;
 	}
+	if(!copy_to_user(fds, kfds, sizeof kfds))
+		exit(-1);
+	return true;
 }
 
-void unpin_string(void *str)
+int mmap(int fd, void *addr)
 {
-	unpin_ptr(str);
-	while(*(char *)str != 0)
-	{
-		str = (char *)str + 1;
-		unpin_ptr(str);
-	}
+	return file_mmap(fd,(void *)addr);
 }
 
-void unpin_buffer(void *buffer, unsigned size)
+void munmap(int mapping)
 {
-	int i;
-	char *local_buffer = (char *)buffer;
-	for(i=0; i<size; i++)
-	{
-		unpin_ptr(local_buffer);
-		local_buffer++;
-	}
+	file_munmap(mapping);
 }
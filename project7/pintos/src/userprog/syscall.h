@@ -4,12 +4,17 @@
 
 #define STACK_HEURISTIC 32
 
+struct intr_frame;
 void syscall_init (void);
+void syscall_handler (struct intr_frame *);
 
 /* add function */
 void check_address(void *addr, void *esp);
-void check_valid_buffer(void *buffer, unsigned size, void *esp, bool to_write);
-void check_valid_string(const void *str, void *esp);
+bool copy_from_user(void *dst, const void *usrc, size_t size);
+bool copy_to_user(void *udst, const void *src, size_t size);
+char *copy_in_string(const char *ustr);
+void pin_user_buffer(void *buffer, unsigned size, void *esp, bool to_write);
+void unpin_user_buffer(void *buffer, unsigned size);
 
 void get_argument(void *esp, int *arg, int count);
 
@@ -26,11 +31,9 @@ int write(int fd, void *buffer, unsigned size);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+bool pipe(int *fds);
 int mmap(int fd, void *addr);
 void munmap(int mapping);
-void unpin_ptr(void *vaddr);
-void unpin_string(void *str);
-void unpin_buffer(void *buffer, unsigned size);
 /* */
 
 #endif /* userprog/syscall.h */
@@ -75,6 +75,32 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers that configure SYSENTER. */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* True if the CPU supports SYSENTER and SYSEXIT. */
+static bool has_sysenter;
+
+void sysenter_entry (void);
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & (1 << 11)) != 0;
+}
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -85,6 +111,16 @@ tss_init (void)
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
+
+  /* SYSENTER loads the kernel data and user code and data
+     selectors from their fixed offsets after SEL_KCSEG, which our
+     GDT follows. */
+  has_sysenter = cpu_has_sysenter ();
+  if (has_sysenter)
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
   tss_update ();
 }
 
@@ -96,11 +132,13 @@ tss_get (void)
   return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the TSS, and the one SYSENTER
+   uses, to point to the end of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  if (has_sysenter)
+    wrmsr (MSR_SYSENTER_ESP, (uint32_t) tss->esp0);
 }
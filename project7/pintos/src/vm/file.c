@@ -1,17 +1,62 @@
 #include "vm/file.h"
 #include "vm/swap.h"
+#include "vm/shm.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "lib/kernel/bitmap.h"
 #include <threads/malloc.h>
 #include <stdio.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* page cache for read-only file-backed pages, keyed by (inode, offset) */
+static struct hash page_cache;
+/* physical page filled with zeros, shared read-only by all VM_ZERO pages */
+void *zero_page;
+
+static unsigned page_cache_hash_func(const struct hash_elem *e, void *aux UNUSED);
+static bool page_cache_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+static void page_cache_remove(struct page *page);
+static void __del_vme_from_page(struct vm_entry *vme);
+static bool page_is_pinned(struct page *page);
+static bool page_is_accessed(struct page *page);
+static bool page_is_dirty(struct page *page);
+static bool page_is_zero(void *kaddr);
+
 void lru_list_init(void)
 {
 	/* initialize */
 	list_init(&lru_list);
 	lock_init(&lru_list_lock);
 	lru_clock = NULL;
+	hash_init(&page_cache, page_cache_hash_func, page_cache_less_func, NULL);
+	/* zero page is never in lru list, so it is never evicted */
+	zero_page = palloc_get_page(PAL_USER | PAL_ZERO);
+	ASSERT(zero_page != NULL);
+}
+
+/* hash cached page by inode and offset */
+static unsigned page_cache_hash_func(const struct hash_elem *e, void *aux UNUSED)
+{
+	struct page *page = hash_entry(e, struct page, cache_elem);
+	return hash_int((int)page->inode) ^ hash_int((int)page->offset);
+}
+
+static bool page_cache_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	struct page *page_a = hash_entry(a, struct page, cache_elem);
+	struct page *page_b = hash_entry(b, struct page, cache_elem);
+
+	if(page_a->inode != page_b->inode)
+		return page_a->inode < page_b->inode;
+	if(page_a->offset != page_b->offset)
+		return page_a->offset < page_b->offset;
+	if(page_a->mmap != page_b->mmap)
+		return page_a->mmap < page_b->mmap;
+	return page_a->read_bytes < page_b->read_bytes;
 }
 
 /* add page to lru list */
@@ -28,11 +73,17 @@ void add_page_to_lru_list(struct page *page)
 /* delete page from lru list */
 void del_page_from_lru_list(struct page* page)
 {
+	struct list_elem *element;
 	if(page != NULL)
 	{
 		if(lru_clock == page)
 		{
-			lru_clock = list_entry(list_remove(&page->lru), struct page, lru);
+			element = list_remove(&page->lru);
+			/* if page was the final page of lru_list, restart from list begin */
+			if(element == list_end(&lru_list))
+				lru_clock = NULL;
+			else
+				lru_clock = list_entry(element, struct page, lru);
 		}
 		else
 			list_remove(&page->lru);
@@ -50,7 +101,8 @@ struct page *alloc_page(enum palloc_flags flags)
 	/* if fail, free physical memory and retry physical memory allocate*/
 	while(kaddr == NULL)
 	{
-		try_to_free_pages();
+		if(try_to_free_pages() == false)
+			return NULL;
 		kaddr = palloc_get_page(flags);
 	}
 	new_page = malloc(sizeof(struct page));
@@ -59,9 +111,14 @@ struct page *alloc_page(enum palloc_flags flags)
 		palloc_free_page(kaddr);
 		return NULL;
 	}
-	/* initialize page */
+	/* initialize page. page which has no vm_entry is never selected as victim,
+	   unless it is a segment page */
 	new_page->kaddr  = kaddr;
-	new_page->pg_thread = thread_current();
+	new_page->ref_cnt = 0;
+	new_page->inode = NULL;
+	new_page->mmap = false;
+	new_page->shm = NULL;
+	list_init(&new_page->vme_list);
 	/* insert page to lru list */
 	add_page_to_lru_list(new_page);
 	return new_page;
@@ -88,6 +145,9 @@ void free_page(void *kaddr)
 
 void __free_page(struct page *page)
 {
+	/* drop page from page cache */
+	if(page->inode != NULL)
+		page_cache_remove(page);
 	/* free physical memory */
 	palloc_free_page(page->kaddr);
 	/* delete page from lru_list */
@@ -95,6 +155,189 @@ void __free_page(struct page *page)
 	free(page);
 }
 
+/* map page to vm_entry and increase reference count */
+void add_vme_to_page(struct page *page, struct vm_entry *vme)
+{
+	lock_acquire(&lru_list_lock);
+	list_push_back(&page->vme_list, &vme->page_elem);
+	page->ref_cnt++;
+	vme->page = page;
+	lock_release(&lru_list_lock);
+}
+
+/* unmap vm_entry's page. if no vm_entry maps the page, free it */
+void del_vme_from_page(struct vm_entry *vme)
+{
+	lock_acquire(&lru_list_lock);
+	__del_vme_from_page(vme);
+	lock_release(&lru_list_lock);
+}
+
+static void __del_vme_from_page(struct vm_entry *vme)
+{
+	struct page *page = vme->page;
+
+	pagedir_clear_page(vme->thread->pagedir, vme->vaddr);
+	vme->is_loaded = false;
+	if(page == NULL)
+		return;
+	vme->page = NULL;
+	list_remove(&vme->page_elem);
+	page->ref_cnt--;
+	/* segment keeps its page until it is evicted or segment is freed */
+	if(page->ref_cnt == 0 && page->shm == NULL)
+		__free_page(page);
+}
+
+/* pin vm_entry so its page is not evicted.
+   return true if page is loaded, else caller must load the page */
+bool pin_page(struct vm_entry *vme)
+{
+	bool loaded;
+
+	lock_acquire(&lru_list_lock);
+	vme->pinned = true;
+	loaded = vme->is_loaded;
+	lock_release(&lru_list_lock);
+	return loaded;
+}
+
+/* find page of inode at offset in page cache, a read-only text page
+   or, for VM_FILE vme, a writable page of a file mapping.
+   if found, map it to vm_entry and return it, else return NULL */
+struct page *page_cache_lookup(struct inode *inode, size_t offset, size_t read_bytes, struct vm_entry *vme)
+{
+	struct page key;
+	struct page *page = NULL;
+	struct hash_elem *element;
+
+	key.inode = inode;
+	key.offset = offset;
+	key.read_bytes = read_bytes;
+	key.mmap = vme->type == VM_FILE;
+	lock_acquire(&lru_list_lock);
+	element = hash_find(&page_cache, &key.cache_elem);
+	if(element != NULL)
+	{
+		page = hash_entry(element, struct page, cache_elem);
+		list_push_back(&page->vme_list, &vme->page_elem);
+		page->ref_cnt++;
+		vme->page = page;
+	}
+	lock_release(&lru_list_lock);
+	return page;
+}
+
+/* insert loaded page into page cache and map it to vm_entry.
+   if another process inserted the same page first, free PAGE and
+   map the cached one instead. return the page mapped to vm_entry */
+struct page *page_cache_insert(struct page *page, struct inode *inode, size_t offset, size_t read_bytes, struct vm_entry *vme)
+{
+	struct hash_elem *element;
+
+	page->inode = inode;
+	page->offset = offset;
+	page->read_bytes = read_bytes;
+	page->mmap = vme->type == VM_FILE;
+	lock_acquire(&lru_list_lock);
+	element = hash_insert(&page_cache, &page->cache_elem);
+	if(element != NULL)
+	{
+		/* lost the race, use already cached page */
+		page->inode = NULL;
+		__free_page(page);
+		page = hash_entry(element, struct page, cache_elem);
+	}
+	else
+	{
+		/* hold inode while cached and deny writes to shared text.
+		   mapped pages are written back to the inode */
+		inode_reopen(inode);
+		if(page->mmap == false)
+			inode_deny_write(inode);
+	}
+	list_push_back(&page->vme_list, &vme->page_elem);
+	page->ref_cnt++;
+	vme->page = page;
+	lock_release(&lru_list_lock);
+	return page;
+}
+
+static void page_cache_remove(struct page *page)
+{
+	struct inode *inode = page->inode;
+
+	hash_delete(&page_cache, &page->cache_elem);
+	page->inode = NULL;
+	if(page->mmap == false)
+		inode_allow_write(inode);
+	inode_close(inode);
+}
+
+/* page is pinned if it is not mapped yet or one of vm_entries is pinned */
+static bool page_is_pinned(struct page *page)
+{
+	struct list_elem *element;
+	struct vm_entry *vme;
+
+	/* page being loaded has no vm_entry yet. segment page nobody
+	   maps is not pinned */
+	if(page->ref_cnt == 0)
+		return page->shm == NULL;
+	for(element = list_begin(&page->vme_list); element != list_end(&page->vme_list); element = list_next(element))
+	{
+		vme = list_entry(element, struct vm_entry, page_elem);
+		if(vme->pinned == true)
+			return true;
+	}
+	return false;
+}
+
+/* check accessed bit of all page tables mapping the page and clear them */
+static bool page_is_accessed(struct page *page)
+{
+	struct list_elem *element;
+	struct vm_entry *vme;
+	bool accessed = false;
+
+	for(element = list_begin(&page->vme_list); element != list_end(&page->vme_list); element = list_next(element))
+	{
+		vme = list_entry(element, struct vm_entry, page_elem);
+		if(pagedir_is_accessed(vme->thread->pagedir, vme->vaddr))
+		{
+			pagedir_set_accessed(vme->thread->pagedir, vme->vaddr, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+static bool page_is_dirty(struct page *page)
+{
+	struct list_elem *element;
+	struct vm_entry *vme;
+
+	for(element = list_begin(&page->vme_list); element != list_end(&page->vme_list); element = list_next(element))
+	{
+		vme = list_entry(element, struct vm_entry, page_elem);
+		if(pagedir_is_dirty(vme->thread->pagedir, vme->vaddr))
+			return true;
+	}
+	return false;
+}
+
+/* return true if every byte of page is zero */
+static bool page_is_zero(void *kaddr)
+{
+	uint32_t *word = kaddr;
+	size_t i;
+
+	for(i = 0; i < PGSIZE / sizeof *word; i++)
+		if(word[i] != 0)
+			return false;
+	return true;
+}
+
 struct list_elem* get_next_lru_clock(void)
 {
 	struct list_elem *element;
@@ -132,58 +375,142 @@ struct list_elem* get_next_lru_clock(void)
 	return element;
 }
 
-void try_to_free_pages(void)
+/* evict a page chosen by clock algorithm. return false if no page
+   could be evicted, because every page is pinned or swap is full */
+bool try_to_free_pages(void)
 {
-	struct thread *page_thread;
 	struct list_elem *element;
 	struct page *lru_page;
+	struct vm_entry *vme = NULL;
+	size_t swap_slot = BITMAP_ERROR;
+	bool swapped = false;
+	bool zeroed = false;
+	int i, sharers;
+	size_t scan_cnt;
 	lock_acquire(&lru_list_lock);
-	if(list_empty(&lru_list) == true)
-	{
-		lock_release(&lru_list_lock);
-		return;
-	}
-	while(true)
+	/* look at every page twice, the first look may only clear
+	   its accessed bits */
+	scan_cnt = 2 * list_size(&lru_list);
+	while(scan_cnt-- > 0)
 	{
 		/* get next element */
 		element = get_next_lru_clock();
-		if(element == NULL){
-			lock_release(&lru_list_lock);
-			return;
-		}
+		if(element == NULL)
+			break;
 		lru_page = list_entry(element, struct page, lru);
-		if(lru_page->vme->pinned == true)
+		if(page_is_pinned(lru_page) == true)
 			continue;
-		page_thread = lru_page->pg_thread;
-		/* if page address is accessed, set accessed bit 0 and continue(it's not victim) */
-		if(pagedir_is_accessed(page_thread->pagedir, lru_page->vme->vaddr))
-		{
-			pagedir_set_accessed(page_thread->pagedir, lru_page->vme->vaddr, false);
+		/* if page address is accessed by any sharer, clear accessed bits and continue(it's not victim) */
+		if(page_is_accessed(lru_page) == true)
 			continue;
-		}
 		/* if not accessed, it's victim */
+		sharers = lru_page->ref_cnt;
+		/* only segment page may have no vm_entry */
+		if(sharers > 0)
+			vme = list_entry(list_front(&lru_page->vme_list), struct vm_entry, page_elem);
+		/* segment page leaves memory as a unit, in a swap slot
+		   of the segment. sharers keep type VM_SHM */
+		if(lru_page->shm != NULL)
+		{
+			swap_slot = BITMAP_ERROR;
+			if(page_is_zero(lru_page->kaddr) == false)
+			{
+				swap_slot = swap_out(lru_page->kaddr);
+				/* swap is full, keep the page and try another */
+				if(swap_slot == BITMAP_ERROR)
+					continue;
+			}
+			shm_page_out(lru_page, swap_slot);
+			/* no vm_entry frees segment page nobody maps */
+			if(sharers == 0)
+			{
+				__free_page(lru_page);
+				lock_release(&lru_list_lock);
+				return true;
+			}
+		}
 		/* if page is dirty */
-		if(pagedir_is_dirty(page_thread->pagedir, lru_page->vme->vaddr) || lru_page->vme->type == VM_ANON)
+		else if(page_is_dirty(lru_page) || vme->type == VM_ANON)
 		{
 			/* if vm_entry is mmap file, don't call swap out.*/
-			if(lru_page->vme->type == VM_FILE)
+			if(vme->type == VM_FILE)
 			{
 				lock_acquire(&file_lock);
-				file_write_at(lru_page->vme->file, lru_page->kaddr ,lru_page->vme->read_bytes, lru_page->vme->offset);
+				file_write_at(vme->file, lru_page->kaddr ,vme->read_bytes, vme->offset);
 				lock_release(&file_lock);
 			}
-			/* if not mmap_file, change type to ANON and call swap_out function */
+			/* all-zero page needs no swap slot, it becomes demand-zero page */
+			else if(page_is_zero(lru_page->kaddr))
+				zeroed = true;
+			/* if not mmap_file, call swap_out function */
 			else
 			{
-				lru_page->vme->type = VM_ANON;
-				lru_page->vme->swap_slot = swap_out(lru_page->kaddr);
- 			}
+				swap_slot = swap_out(lru_page->kaddr);
+				/* swap is full, keep the page and try another */
+				if(swap_slot == BITMAP_ERROR)
+					continue;
+				swapped = true;
+			}
+		}
+		/* unmap the page from all page tables which share it.
+		   the page is freed when the last vm_entry is removed */
+		for(i = sharers; i > 0; i--)
+		{
+			vme = list_entry(list_front(&lru_page->vme_list), struct vm_entry, page_elem);
+			if(zeroed == true)
+				vme->type = VM_ZERO;
+			else if(swapped == true)
+			{
+				/* change type to ANON. every sharer refers the same swap slot */
+				vme->type = VM_ANON;
+				vme->swap_slot = swap_slot;
+				if(i != sharers)
+					swap_dup(swap_slot);
+			}
+			__del_vme_from_page(vme);
+		}
+		lock_release(&lru_list_lock);
+		return true;
+	}
+	lock_release(&lru_list_lock);
+	return false;
+}
+
+/* make NEW_VME of forked process refer the same page or swap slot as
+   parent's VME. writable private page becomes copy-on-write in both
+   processes, mmap'd page stays writable and shared */
+bool share_vme_page(struct vm_entry *vme, struct vm_entry *new_vme)
+{
+	struct page *page;
+	uint32_t *pd = vme->thread->pagedir;
+	bool writable;
+	bool success = true;
+
+	lock_acquire(&lru_list_lock);
+	new_vme->type = vme->type;
+	new_vme->swap_slot = vme->swap_slot;
+	page = vme->page;
+	if(page != NULL)
+	{
+		writable = vme->writable && vme->type == VM_FILE;
+		if(pagedir_set_page(new_vme->thread->pagedir, new_vme->vaddr, page->kaddr, writable) == false)
+			success = false;
+		else
+		{
+			/* write protect parent's page */
+			if(vme->writable == true && writable == false)
+				pagedir_set_writable(pd, vme->vaddr, false);
+			/* page differs from file if parent modified it */
+			if(pagedir_is_dirty(pd, vme->vaddr))
+				pagedir_set_dirty(new_vme->thread->pagedir, new_vme->vaddr, true);
+			list_push_back(&page->vme_list, &new_vme->page_elem);
+			page->ref_cnt++;
+			new_vme->page = page;
+			new_vme->is_loaded = true;
 		}
-		lru_page->vme->is_loaded = false;
-		pagedir_clear_page(page_thread->pagedir, lru_page->vme->vaddr);
-		__free_page(lru_page);
-		break;
 	}
-    lock_release(&lru_list_lock);
-	return;
+	else if(vme->type == VM_ANON)
+		swap_dup(vme->swap_slot);
+	lock_release(&lru_list_lock);
+	return success;
 }
@@ -3,12 +3,21 @@
 #include "vm/page.h"
 #include "lib/kernel/list.h"
 #include <threads/palloc.h>
+struct inode;
+/* shared read-only page filled with zeros */
+extern void *zero_page;
 void lru_list_init(void);
 void add_page_to_lru_list(struct page *page);
 void del_page_from_lru_list(struct page *page);
 struct page *alloc_page(enum palloc_flags flag);
 void free_page(void *kaddr);
 void __free_page(struct page *page);
+void add_vme_to_page(struct page *page, struct vm_entry *vme);
+void del_vme_from_page(struct vm_entry *vme);
+bool pin_page(struct vm_entry *vme);
+struct page *page_cache_lookup(struct inode *inode, size_t offset, size_t read_bytes, struct vm_entry *vme);
+struct page *page_cache_insert(struct page *page, struct inode *inode, size_t offset, size_t read_bytes, struct vm_entry *vme);
+bool share_vme_page(struct vm_entry *vme, struct vm_entry *new_vme);
 struct list_elem* get_next_lru_clock(void);
-void try_to_free_pages(void);
+bool try_to_free_pages(void);
 #endif 
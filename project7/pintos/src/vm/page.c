@@ -6,6 +6,7 @@
 #include "filesys/file.h"
 #include "vm/page.h"
 #include "vm/file.h"
+#include "vm/swap.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
@@ -17,6 +18,7 @@
 static bool vm_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
 static unsigned vm_hash_func(const struct hash_elem *e, void *aux UNUSED);
 static void vm_destroy_func(struct hash_elem *e, void *aux UNUSED);
+static struct vm_entry *copy_vme(struct vm_entry *vme);
 
 /* if a's vm_entry adress is less than b's vm_entry address return true */
 static bool vm_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
@@ -40,16 +42,13 @@ static unsigned vm_hash_func(const struct hash_elem *e, void *aux UNUSED)
 static void vm_destroy_func(struct hash_elem *e, void *aux UNUSED)
 {
 	struct vm_entry *vme = hash_entry(e, struct vm_entry, elem);
-	void *physical_address;
-	/* if virtual address is loaded on physical memory */
+	/* if virtual address is loaded on physical memory,
+	   clear page table and release the page */
 	if(vme->is_loaded == true)
-	{
-		/*get physical_address and free page */
-		physical_address = pagedir_get_page(thread_current()->pagedir, vme->vaddr);
-		free_page(physical_address);
-		/* clear page table */
-		pagedir_clear_page(thread_current()->pagedir, vme->vaddr);
-	}
+		del_vme_from_page(vme);
+	/* if page is swapped out, release the swap slot */
+	else if(vme->type == VM_ANON)
+		swap_free(vme->swap_slot);
 	/* free vm_entry */
 	free(vme);
 }
@@ -82,6 +81,9 @@ struct vm_entry *find_vme(void *vaddr)
 bool insert_vme(struct hash *vm, struct vm_entry *vme)
 {
 	bool result = false;
+	/* vm_entry is owned by the thread which inserts it */
+	vme->thread = thread_current();
+	vme->page = NULL;
 	/* if hash_insert is success, return true */
 	if(hash_insert(vm, &vme->elem) == NULL)
 		result = true;
@@ -98,6 +100,104 @@ bool delete_vme(struct hash *vm, struct vm_entry *vme)
 	return result;   
 }
 
+/* allocate new vm_entry with the same mapping as VME */
+static struct vm_entry *copy_vme(struct vm_entry *vme)
+{
+	struct vm_entry *new_vme = malloc(sizeof(struct vm_entry));
+	if(new_vme == NULL)
+		return NULL;
+	new_vme->type       = vme->type;
+	new_vme->vaddr      = vme->vaddr;
+	new_vme->writable   = vme->writable;
+	new_vme->is_loaded  = false;
+	new_vme->pinned     = false;
+	new_vme->file       = vme->file;
+	new_vme->shm        = vme->shm;
+	new_vme->offset     = vme->offset;
+	new_vme->read_bytes = vme->read_bytes;
+	new_vme->zero_bytes = vme->zero_bytes;
+	new_vme->swap_slot  = vme->swap_slot;
+	return new_vme;
+}
+
+/* copy parent's vm_entries except mmap'd ones to current thread for fork.
+   loaded pages are shared with parent, swapped pages share the swap slot */
+bool vm_copy(struct thread *parent)
+{
+	struct thread *cur = thread_current();
+	struct hash_iterator i;
+	struct vm_entry *vme;
+	struct vm_entry *new_vme;
+
+	hash_first(&i, &parent->vm);
+	while(hash_next(&i))
+	{
+		vme = hash_entry(hash_cur(&i), struct vm_entry, elem);
+		/* mmap'd pages are copied by mmap_copy, shared memory by shm_copy */
+		if(vme->type == VM_FILE || vme->type == VM_SHM)
+			continue;
+		new_vme = copy_vme(vme);
+		if(new_vme == NULL)
+			return false;
+		if(insert_vme(&cur->vm, new_vme) == false)
+		{
+			free(new_vme);
+			return false;
+		}
+		if(share_vme_page(vme, new_vme) == false)
+			return false;
+	}
+	return true;
+}
+
+/* copy parent's mmap_files to current thread for fork.
+   the child maps the same file pages as parent */
+bool mmap_copy(struct thread *parent)
+{
+	struct thread *cur = thread_current();
+	struct list_elem *element;
+	struct list_elem *vme_element;
+	struct mmap_file *map_file;
+	struct mmap_file *new_map_file;
+	struct vm_entry *vme;
+	struct vm_entry *new_vme;
+
+	for(element = list_begin(&parent->mmap_list); element != list_end(&parent->mmap_list); element = list_next(element))
+	{
+		map_file = list_entry(element, struct mmap_file, elem);
+		new_map_file = malloc(sizeof(struct mmap_file));
+		if(new_map_file == NULL)
+			return false;
+		new_map_file->file = file_reopen(map_file->file);
+		if(new_map_file->file == NULL)
+		{
+			free(new_map_file);
+			return false;
+		}
+		new_map_file->mapid = map_file->mapid;
+		list_init(&new_map_file->vme_list);
+		list_push_back(&cur->mmap_list, &new_map_file->elem);
+		for(vme_element = list_begin(&map_file->vme_list); vme_element != list_end(&map_file->vme_list); vme_element = list_next(vme_element))
+		{
+			vme = list_entry(vme_element, struct vm_entry, mmap_elem);
+			new_vme = copy_vme(vme);
+			if(new_vme == NULL)
+				return false;
+			new_vme->file = new_map_file->file;
+			if(insert_vme(&cur->vm, new_vme) == false)
+			{
+				free(new_vme);
+				return false;
+			}
+			list_push_back(&new_map_file->vme_list, &new_vme->mmap_elem);
+			if(share_vme_page(vme, new_vme) == false)
+				return false;
+		}
+	}
+	cur->mapid = parent->mapid;
+	return true;
+}
+
 bool load_file(void *kaddr, struct vm_entry *vme)
 {
 	bool result = false;   
@@ -128,6 +228,9 @@ int file_mmap(int fd, void *addr)
 	{
 		return -1;
 	}
+	/* pipe has no data to map */
+	if(process_get_file(fd) == NULL || file_is_pipe(process_get_file(fd)))
+		return -1;
 	mmap_file_entry = malloc(sizeof(struct mmap_file));
 	if(mmap_file_entry == NULL)
 		return -1;
@@ -221,7 +324,6 @@ void do_munmap(struct mmap_file *mmap_file)
 	struct list_elem *tmp;
 	struct list *vm_list = &(mmap_file->vme_list);
 	struct vm_entry *vme;
-	void *physical_address;
 	/* remove all vm_entry */
 	for(element = list_begin(vm_list); element != list_end(vm_list); element = list_next(element))
 	{
@@ -229,7 +331,6 @@ void do_munmap(struct mmap_file *mmap_file)
 		/* if vm_entry is loaded to physical memory */
 		if(vme->is_loaded == true)
 		{
-			physical_address = pagedir_get_page(cur->pagedir, vme->vaddr);
 			/* if vm_entry's physical memory is dirty, write to disk */
 			if(pagedir_is_dirty(cur->pagedir, vme->vaddr) == true)
 			{
@@ -237,10 +338,8 @@ void do_munmap(struct mmap_file *mmap_file)
 				file_write_at(vme->file, vme->vaddr, vme->read_bytes, vme->offset);
 				lock_release(&file_lock);
 			}
-			/* clear page table */
-			pagedir_clear_page(cur->pagedir, vme->vaddr);
-			/* free physical memory */
-			free_page(physical_address);
+			/* clear page table and free physical memory */
+			del_vme_from_page(vme);
 		}
 		/* remove from vme_list*/
 		tmp = list_prev(element);
@@ -3,24 +3,33 @@
 
 #include <hash.h>
 
+struct thread;
+struct shm;
+
 #define VM_BIN 1 
 #define VM_FILE 2
 #define VM_ANON 3
+#define VM_ZERO 4
+#define VM_SHM 5
 #define CLOSE_ALL 9999
 /* struct for vm_entry */
 struct vm_entry{
-	uint8_t type;                      // VM_BIN, VM_FILE, VM_ANON
+	uint8_t type;                      // VM_BIN, VM_FILE, VM_ANON, VM_ZERO, VM_SHM
 	void *vaddr;                       // virtual address 
 	bool writable;                     
 	bool is_loaded;                    // if true, physical memory is loaded
 	bool pinned;
 	struct file *file;
+	struct shm *shm;                   // segment of VM_SHM page, offset is its offset
 	struct list_elem mmap_elem;        // list_elem for mmap_file's vm_list
 	size_t offset;
 	size_t read_bytes;                   
 	size_t zero_bytes;
 	size_t swap_slot;
 	struct hash_elem elem;             // hash elem for thread's vm
+	struct thread *thread;             // thread which owns this vm_entry
+	struct page *page;                 // physical page mapped to vaddr
+	struct list_elem page_elem;        // list_elem for page's vme_list
 };
 
 /* struct for mmap_file*/
@@ -34,8 +43,14 @@ struct mmap_file{
 /* struct for page */
 struct page{
 	void *kaddr;
-	struct vm_entry *vme;
-	struct thread *pg_thread;
+	struct list vme_list;              // vm_entries which map this page
+	int ref_cnt;                       // number of vm_entries in vme_list
+	struct inode *inode;               // if not NULL, page is in page cache
+	size_t offset;                     // offset of cached page in inode, or of segment page in segment
+	size_t read_bytes;                 // bytes of cached page read from inode
+	bool mmap;                         // cached page is a writable page of a file mapping
+	struct shm *shm;                   // if not NULL, page belongs to shared memory segment
+	struct hash_elem cache_elem;       // hash elem for page cache
 	struct list_elem lru;
 };
 
@@ -44,10 +59,9 @@ void vm_destroy(struct hash *vm);
 struct vm_entry *find_vme(void *vaddr);
 bool insert_vme(struct hash *vm, struct vm_entry *vme);
 bool delete_vme(struct hash *vm, struct vm_entry *vme);
-struct vm_entry *find_vme(void *vaddr);
-bool insert_vme(struct hash *vm, struct vm_entry *vme);
-bool delete_vme(struct hash *vm, struct vm_entry *vme);
 bool load_file(void *kaddr, struct vm_entry *vme);
+bool vm_copy(struct thread *parent);
+bool mmap_copy(struct thread *parent);
 int file_mmap(int fd, void *addr);
 void file_munmap(int mapping);
 void do_munmap(struct mmap_file *mmap_file);
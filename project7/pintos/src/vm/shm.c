@@ -0,0 +1,345 @@
+#include "vm/shm.h"
+#include "vm/page.h"
+#include "vm/file.h"
+#include "vm/swap.h"
+#include "userprog/pagedir.h"
+#include "lib/kernel/bitmap.h"
+#include <threads/malloc.h>
+#include <threads/palloc.h>
+#include <round.h>
+#include "threads/vaddr.h"
+
+/* Segment pages are shared struct pages mapped by a vm_entry of
+   every attached process, like page cache pages. When evicted, a
+   segment page leaves memory as a unit: its contents go to one swap
+   slot owned by the segment and every sharer faults the same page
+   back in. A segment page nobody maps stays on the lru list and is
+   evicted the same way. */
+
+/* all segments */
+static struct list shm_list;
+/* protects shm_list, ids and ref_cnt of segments */
+static struct lock shm_lock;
+static int next_shm_id;
+
+static struct shm *find_shm(int id);
+static void shm_put(struct shm *shm);
+static bool attach_pages(struct thread *t, struct shm *shm, void *addr);
+static void detach_pages(struct shm_map *map);
+
+void shm_init(void)
+{
+	list_init(&shm_list);
+	lock_init(&shm_lock);
+	next_shm_id = 1;
+}
+
+/* find segment of id. must hold shm_lock */
+static struct shm *find_shm(int id)
+{
+	struct list_elem *element;
+	struct shm *shm;
+
+	for(element = list_begin(&shm_list); element != list_end(&shm_list); element = list_next(element))
+	{
+		shm = list_entry(element, struct shm, elem);
+		if(shm->id == id)
+			return shm;
+	}
+	return NULL;
+}
+
+/* drop a reference to segment. last reference frees its pages and
+   swap slots */
+static void shm_put(struct shm *shm)
+{
+	size_t i;
+
+	lock_acquire(&shm_lock);
+	if(--shm->ref_cnt > 0)
+	{
+		lock_release(&shm_lock);
+		return;
+	}
+	list_remove(&shm->elem);
+	lock_release(&shm_lock);
+
+	/* nothing maps the pages any more */
+	lock_acquire(&lru_list_lock);
+	for(i = 0; i < shm->page_cnt; i++)
+	{
+		if(shm->pages[i] != NULL)
+		{
+			shm->pages[i]->shm = NULL;
+			__free_page(shm->pages[i]);
+		}
+	}
+	lock_release(&lru_list_lock);
+	for(i = 0; i < shm->page_cnt; i++)
+		swap_free(shm->swap_slots[i]);
+	free(shm->pages);
+	free(shm->swap_slots);
+	free(shm);
+}
+
+/* create segment of size bytes, zero filled. it lives while its
+   creator runs or any process has it attached.
+   return id of segment, or -1 */
+int shm_create(size_t size)
+{
+	struct shm *shm;
+	size_t i;
+
+	if(size == 0 || size > SHM_MAX_PAGES * PGSIZE)
+		return -1;
+	shm = malloc(sizeof(struct shm));
+	if(shm == NULL)
+		return -1;
+	shm->page_cnt = DIV_ROUND_UP(size, PGSIZE);
+	shm->pages = calloc(shm->page_cnt, sizeof *shm->pages);
+	shm->swap_slots = malloc(shm->page_cnt * sizeof *shm->swap_slots);
+	if(shm->pages == NULL || shm->swap_slots == NULL)
+	{
+		free(shm->pages);
+		free(shm->swap_slots);
+		free(shm);
+		return -1;
+	}
+	for(i = 0; i < shm->page_cnt; i++)
+		shm->swap_slots[i] = BITMAP_ERROR;
+	shm->ref_cnt = 1;
+	shm->creator = thread_current()->tid;
+	lock_init(&shm->lock);
+	lock_acquire(&shm_lock);
+	shm->id = next_shm_id++;
+	list_push_back(&shm_list, &shm->elem);
+	lock_release(&shm_lock);
+	return shm->id;
+}
+
+/* add vm_entries of segment at addr to thread t and record the
+   attachment. pages are brought in on fault */
+static bool attach_pages(struct thread *t, struct shm *shm, void *addr)
+{
+	struct shm_map *map;
+	struct vm_entry *vme;
+	size_t i;
+
+	map = malloc(sizeof(struct shm_map));
+	if(map == NULL)
+		return false;
+	map->shm = shm;
+	map->addr = addr;
+	list_push_back(&t->shm_list, &map->elem);
+	for(i = 0; i < shm->page_cnt; i++)
+	{
+		vme = malloc(sizeof(struct vm_entry));
+		if(vme == NULL)
+			break;
+		vme->type      = VM_SHM;
+		vme->vaddr     = addr + i * PGSIZE;
+		vme->writable  = true;
+		vme->is_loaded = false;
+		vme->pinned    = false;
+		vme->file      = NULL;
+		vme->shm       = shm;
+		vme->offset    = i * PGSIZE;
+		vme->swap_slot = BITMAP_ERROR;
+		if(insert_vme(&t->vm, vme) == false)
+		{
+			free(vme);
+			break;
+		}
+	}
+	/* undo if some page could not be added */
+	if(i < shm->page_cnt)
+	{
+		detach_pages(map);
+		return false;
+	}
+	return true;
+}
+
+/* remove vm_entries of attachment from current thread and free it */
+static void detach_pages(struct shm_map *map)
+{
+	struct thread *cur = thread_current();
+	struct vm_entry *vme;
+	size_t i;
+
+	for(i = 0; i < map->shm->page_cnt; i++)
+	{
+		vme = find_vme(map->addr + i * PGSIZE);
+		if(vme == NULL || vme->type != VM_SHM || vme->shm != map->shm)
+			break;
+		if(vme->is_loaded == true)
+			del_vme_from_page(vme);
+		delete_vme(&cur->vm, vme);
+	}
+	list_remove(&map->elem);
+	free(map);
+}
+
+/* map segment of id at page aligned addr of current process.
+   every page of it must be free */
+bool shm_attach(int id, void *addr)
+{
+	struct thread *cur = thread_current();
+	struct shm *shm;
+	size_t i;
+
+	if(addr == NULL || pg_ofs(addr) != 0)
+		return false;
+	lock_acquire(&shm_lock);
+	shm = find_shm(id);
+	if(shm != NULL)
+		shm->ref_cnt++;
+	lock_release(&shm_lock);
+	if(shm == NULL)
+		return false;
+	for(i = 0; i < shm->page_cnt; i++)
+	{
+		void *upage = addr + i * PGSIZE;
+		if(!is_user_vaddr(upage) || upage < addr || find_vme(upage) != NULL)
+			break;
+	}
+	if(i < shm->page_cnt || attach_pages(cur, shm, addr) == false)
+	{
+		shm_put(shm);
+		return false;
+	}
+	return true;
+}
+
+/* unmap segment attached at addr from current process */
+bool shm_detach(void *addr)
+{
+	struct thread *cur = thread_current();
+	struct list_elem *element;
+	struct shm_map *map;
+	struct shm *shm;
+
+	for(element = list_begin(&cur->shm_list); element != list_end(&cur->shm_list); element = list_next(element))
+	{
+		map = list_entry(element, struct shm_map, elem);
+		if(map->addr == addr)
+		{
+			shm = map->shm;
+			detach_pages(map);
+			shm_put(shm);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* attach parent's segments at the same addresses for fork */
+bool shm_copy(struct thread *parent)
+{
+	struct thread *cur = thread_current();
+	struct list_elem *element;
+	struct shm_map *map;
+
+	for(element = list_begin(&parent->shm_list); element != list_end(&parent->shm_list); element = list_next(element))
+	{
+		map = list_entry(element, struct shm_map, elem);
+		lock_acquire(&shm_lock);
+		map->shm->ref_cnt++;
+		lock_release(&shm_lock);
+		if(attach_pages(cur, map->shm, map->addr) == false)
+		{
+			shm_put(map->shm);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* detach every segment of exiting process and drop its creator
+   references */
+void shm_exit(void)
+{
+	struct thread *cur = thread_current();
+	struct list_elem *element;
+	struct shm *shm;
+
+	while(!list_empty(&cur->shm_list))
+		shm_detach(list_entry(list_front(&cur->shm_list), struct shm_map, elem)->addr);
+	/* shm_put may free a segment, so search again after each one */
+	for(;;)
+	{
+		shm = NULL;
+		lock_acquire(&shm_lock);
+		for(element = list_begin(&shm_list); element != list_end(&shm_list); element = list_next(element))
+		{
+			if(list_entry(element, struct shm, elem)->creator == cur->tid)
+			{
+				shm = list_entry(element, struct shm, elem);
+				shm->creator = TID_ERROR;
+				break;
+			}
+		}
+		lock_release(&shm_lock);
+		if(shm == NULL)
+			break;
+		shm_put(shm);
+	}
+}
+
+/* find page of segment mapped by vme, reading it from swap or
+   zeroing a new one if it is not resident, and add vme to it.
+   return the page, or NULL if memory is not available */
+struct page *shm_get_page(struct vm_entry *vme)
+{
+	struct shm *shm = vme->shm;
+	size_t idx = vme->offset / PGSIZE;
+	size_t slot;
+	struct page *page;
+
+	/* one fault at a time brings in pages of the segment */
+	lock_acquire(&shm->lock);
+	lock_acquire(&lru_list_lock);
+	page = shm->pages[idx];
+	if(page != NULL)
+	{
+		list_push_back(&page->vme_list, &vme->page_elem);
+		page->ref_cnt++;
+		vme->page = page;
+	}
+	lock_release(&lru_list_lock);
+	if(page == NULL)
+	{
+		/* only eviction of a resident page changes its slot */
+		slot = shm->swap_slots[idx];
+		page = alloc_page(slot == BITMAP_ERROR ? PAL_USER | PAL_ZERO : PAL_USER);
+		if(page != NULL)
+		{
+			if(slot != BITMAP_ERROR)
+				swap_in(slot, page->kaddr);
+			shm->swap_slots[idx] = BITMAP_ERROR;
+			lock_acquire(&lru_list_lock);
+			page->shm = shm;
+			page->offset = vme->offset;
+			shm->pages[idx] = page;
+			list_push_back(&page->vme_list, &vme->page_elem);
+			page->ref_cnt++;
+			vme->page = page;
+			lock_release(&lru_list_lock);
+		}
+	}
+	lock_release(&shm->lock);
+	return page;
+}
+
+/* record that evicted segment page is kept in swap slot, or
+   BITMAP_ERROR if it is all zeros. the caller unmaps it from every
+   sharer, or frees it if nobody maps it. must hold lru_list_lock */
+void shm_page_out(struct page *page, size_t slot)
+{
+	struct shm *shm = page->shm;
+	size_t idx = page->offset / PGSIZE;
+
+	shm->swap_slots[idx] = slot;
+	shm->pages[idx] = NULL;
+	page->shm = NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef SHM_H
+#define SHM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "lib/kernel/list.h"
+
+/* most pages in one shared memory segment */
+#define SHM_MAX_PAGES 1024
+
+struct vm_entry;
+struct page;
+
+/* anonymous shared memory segment */
+struct shm{
+	int id;
+	size_t page_cnt;
+	int ref_cnt;                       // attachments, plus one while creator runs
+	tid_t creator;                     // TID_ERROR after creator exits
+	struct lock lock;                  // serializes faults on segment pages
+	struct page **pages;               // resident page of each index, or NULL
+	size_t *swap_slots;                // swap slot of page not resident, or BITMAP_ERROR
+	struct list_elem elem;             // list_elem for shm_list
+};
+
+/* segment attached to a process */
+struct shm_map{
+	struct shm *shm;
+	void *addr;                        // address of first page
+	struct list_elem elem;             // list_elem for thread's shm_list
+};
+
+void shm_init(void);
+int shm_create(size_t size);
+bool shm_attach(int id, void *addr);
+bool shm_detach(void *addr);
+bool shm_copy(struct thread *parent);
+void shm_exit(void);
+struct page *shm_get_page(struct vm_entry *vme);
+void shm_page_out(struct page *page, size_t slot);
+#endif
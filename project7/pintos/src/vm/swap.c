@@ -1,16 +1,28 @@
 #include "vm/file.h"
 #include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/zswap.h"
 #include "devices/block.h"
 #include "threads/synch.h"
 #include "lib/kernel/bitmap.h"
+#include <threads/malloc.h>
+#include <stdio.h>
 
 struct lock swap_lock;
 struct bitmap *swap_map;
 struct block *swap_block;
+/* number of vm_entries which refer to each swap slot */
+static int *swap_ref;
+/* pages read from and written to swap disk */
+static long long disk_in_cnt;
+static long long disk_out_cnt;
 
 void swap_init(void)
 {
+	/* initialize lock value */
+	lock_init(&swap_lock);
+	/* compressed pool in front of swap disk */
+	zswap_init();
 	/* get swap_block. */
 	swap_block = block_get_role(BLOCK_SWAP);
 	if(swap_block == NULL)
@@ -21,25 +33,43 @@ void swap_init(void)
 		return;
 	/* initialize bitmap */
 	bitmap_set_all(swap_map, SWAP_FREE);
-	/* initialize lock value */
-	lock_init(&swap_lock);
+	/* create reference count of swap slots */
+	swap_ref = calloc(bitmap_size(swap_map), sizeof *swap_ref);
+	if(swap_ref == NULL)
+		return;
 }
 
 void swap_in(size_t used_index, void* kaddr)
 {
 	int i;
+	/* BITMAP_ERROR has ZSWAP_SLOT bit set, but is no slot */
+	if(used_index == BITMAP_ERROR)
+		return;
 	lock_acquire(&swap_lock);
-	
+
+	/* page is compressed in memory */
+	if(used_index & ZSWAP_SLOT)
+	{
+		zswap_load(used_index, kaddr);
+		lock_release(&swap_lock);
+		return;
+	}
 	/* check if used_index is empty slot */
 	if(bitmap_test(swap_map, used_index) == SWAP_FREE)
+	{
+		lock_release(&swap_lock);
 		return;
+	}
 	/* read from swap disk to physical memory */
 	for(i=0; i<SECTORS_PER_PAGE; i++)
 	{
 		block_read(swap_block, used_index * SECTORS_PER_PAGE + i, (uint8_t *)kaddr + i * BLOCK_SECTOR_SIZE);
 	}
-	/* change bitmap 1 to 0 */
-	bitmap_flip(swap_map, used_index);
+	disk_in_cnt++;
+	/* if no other process refers the slot, change bitmap 1 to 0 */
+	swap_ref[used_index]--;
+	if(swap_ref[used_index] == 0)
+		bitmap_flip(swap_map, used_index);
 	lock_release(&swap_lock);
 }
 
@@ -49,16 +79,67 @@ size_t swap_out(void *kaddr)
 	size_t free_index;
 	lock_acquire(&swap_lock);
 
+	/* try to keep the page compressed in memory first */
+	free_index = zswap_store(kaddr);
+	if(free_index != BITMAP_ERROR)
+	{
+		lock_release(&swap_lock);
+		return free_index;
+	}
 	/* find SWAP_FREE index. if there is no SWAP_FREE index, return*/
-	free_index = bitmap_scan_and_flip(swap_map, 0, 1, SWAP_FREE);
+	if(swap_map != NULL)
+		free_index = bitmap_scan_and_flip(swap_map, 0, 1, SWAP_FREE);
 	if(free_index == BITMAP_ERROR)
+	{
+		lock_release(&swap_lock);
 		return BITMAP_ERROR;
+	}
+	swap_ref[free_index] = 1;
 	/* write to swap disk */
 	for(i=0; i<SECTORS_PER_PAGE; i++)
 	{
 		block_write(swap_block, free_index * SECTORS_PER_PAGE + i, (uint8_t *)kaddr + i * BLOCK_SECTOR_SIZE);
 	}
+	disk_out_cnt++;
 
 	lock_release(&swap_lock);
 	return free_index;
 }
+
+/* add reference to swap slot shared by forked process */
+void swap_dup(size_t used_index)
+{
+	if(used_index == BITMAP_ERROR)
+		return;
+	lock_acquire(&swap_lock);
+	if(used_index & ZSWAP_SLOT)
+		zswap_dup(used_index);
+	else
+		swap_ref[used_index]++;
+	lock_release(&swap_lock);
+}
+
+/* drop reference to swap slot without reading it */
+void swap_free(size_t used_index)
+{
+	if(used_index == BITMAP_ERROR)
+		return;
+	lock_acquire(&swap_lock);
+	if(used_index & ZSWAP_SLOT)
+		zswap_free(used_index);
+	else if(bitmap_test(swap_map, used_index) == SWAP_USED)
+	{
+		swap_ref[used_index]--;
+		if(swap_ref[used_index] == 0)
+			bitmap_flip(swap_map, used_index);
+	}
+	lock_release(&swap_lock);
+}
+
+/* print how many swapped pages were served from memory and disk */
+void swap_print_stats(void)
+{
+	printf("Swap: %lld pages written to disk, %lld pages read from disk\n",
+	       disk_out_cnt, disk_in_cnt);
+	zswap_print_stats();
+}
@@ -8,4 +8,7 @@
 void swap_init(void);
 void swap_in(size_t used_index, void* kaddr);
 size_t swap_out(void* kaddr);
+void swap_dup(size_t used_index);
+void swap_free(size_t used_index);
+void swap_print_stats(void);
 #endif
@@ -0,0 +1,247 @@
+#include "vm/zswap.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <round.h>
+#include <threads/malloc.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "lib/kernel/bitmap.h"
+
+/* Compressed in-memory tier in front of the swap partition.
+   swap_out() first tries to store the page here, and the page only
+   goes to the swap disk if it does not compress well or the pool is
+   full.  Pages filled with one repeated word take no pool space,
+   other pages are run-length encoded into ZSWAP_UNIT sized chunks of
+   a contiguous pool of kernel pages.
+   All functions are called with swap_lock held. */
+
+#define ZSWAP_UNIT 32                          /* allocation unit of pool */
+#define ZSWAP_UNITS (ZSWAP_PAGES * PGSIZE / ZSWAP_UNIT)
+#define ZSWAP_MAX_SIZE (PGSIZE / 2)            /* store only if compressed to half */
+#define ZSWAP_MIN_RUN 3                        /* shortest run worth encoding */
+#define ZSWAP_MAX_RUN (0x7f + ZSWAP_MIN_RUN)
+#define ZSWAP_MAX_LITERAL 0x80
+
+/* compressed page */
+struct zswap_entry{
+	size_t start;                      // first unit in pool
+	size_t len;                        // compressed bytes, 0 if same filled
+	uint32_t fill;                     // word repeated in same filled page
+	int ref_cnt;                       // vm_entries referring this entry
+};
+
+static uint8_t *pool;                  // compressed data
+static struct bitmap *pool_map;        // used units of pool
+static struct bitmap *entry_map;       // used entries
+static struct zswap_entry *entries;
+static uint8_t zswap_buf[PGSIZE];      // compression output
+
+/* statistics */
+static long long store_cnt;            // pages stored in pool
+static long long same_filled_cnt;      // pages stored as a single word
+static long long reject_cnt;           // pages which did not compress well
+static long long full_cnt;             // pages spilled because pool is full
+static long long load_cnt;             // pages loaded from pool
+static long long bytes_in;             // uncompressed bytes stored
+static long long bytes_out;            // compressed bytes stored
+
+static bool same_filled(const uint32_t *page, uint32_t *fill);
+static size_t compress_page(const uint8_t *src, uint8_t *dst);
+static void decompress_page(const uint8_t *src, uint8_t *dst);
+
+void zswap_init(void)
+{
+	pool = palloc_get_multiple(0, ZSWAP_PAGES);
+	pool_map = bitmap_create(ZSWAP_UNITS);
+	entry_map = bitmap_create(ZSWAP_ENTRIES);
+	entries = calloc(ZSWAP_ENTRIES, sizeof *entries);
+	/* if fail, every page goes to swap disk */
+	if(pool == NULL || pool_map == NULL || entry_map == NULL || entries == NULL)
+	{
+		printf("zswap: cannot allocate compressed pool, disabled\n");
+		pool = NULL;
+		return;
+	}
+	bitmap_set_all(pool_map, false);
+	bitmap_set_all(entry_map, false);
+}
+
+/* compress page at KADDR into pool.
+   return its swap slot, or BITMAP_ERROR if page must go to disk */
+size_t zswap_store(void *kaddr)
+{
+	struct zswap_entry *entry;
+	size_t index;
+	size_t len = 0;
+	size_t start = 0;
+	uint32_t fill = 0;
+
+	if(pool == NULL)
+		return BITMAP_ERROR;
+	if(same_filled(kaddr, &fill) == false)
+	{
+		len = compress_page(kaddr, zswap_buf);
+		if(len == 0)
+		{
+			reject_cnt++;
+			return BITMAP_ERROR;
+		}
+		start = bitmap_scan_and_flip(pool_map, 0, DIV_ROUND_UP(len, ZSWAP_UNIT), false);
+		if(start == BITMAP_ERROR)
+		{
+			full_cnt++;
+			return BITMAP_ERROR;
+		}
+	}
+	index = bitmap_scan_and_flip(entry_map, 0, 1, false);
+	if(index == BITMAP_ERROR)
+	{
+		if(len != 0)
+			bitmap_set_multiple(pool_map, start, DIV_ROUND_UP(len, ZSWAP_UNIT), false);
+		full_cnt++;
+		return BITMAP_ERROR;
+	}
+	entry = &entries[index];
+	entry->start = start;
+	entry->len = len;
+	entry->fill = fill;
+	entry->ref_cnt = 1;
+	if(len != 0)
+		memcpy(pool + start * ZSWAP_UNIT, zswap_buf, len);
+	else
+		same_filled_cnt++;
+	store_cnt++;
+	bytes_in += PGSIZE;
+	bytes_out += len;
+	return index | ZSWAP_SLOT;
+}
+
+/* decompress page of swap slot INDEX to KADDR and drop the reference */
+void zswap_load(size_t index, void *kaddr)
+{
+	struct zswap_entry *entry = &entries[index & ~ZSWAP_SLOT];
+	uint32_t *word = kaddr;
+	size_t i;
+
+	if(entry->len == 0)
+	{
+		for(i = 0; i < PGSIZE / sizeof *word; i++)
+			word[i] = entry->fill;
+	}
+	else
+		decompress_page(pool + entry->start * ZSWAP_UNIT, kaddr);
+	load_cnt++;
+	zswap_free(index);
+}
+
+/* add reference to compressed page shared by forked process */
+void zswap_dup(size_t index)
+{
+	entries[index & ~ZSWAP_SLOT].ref_cnt++;
+}
+
+/* drop reference, and release pool space if no one refers the page */
+void zswap_free(size_t index)
+{
+	struct zswap_entry *entry;
+
+	index &= ~ZSWAP_SLOT;
+	entry = &entries[index];
+	entry->ref_cnt--;
+	if(entry->ref_cnt > 0)
+		return;
+	if(entry->len != 0)
+		bitmap_set_multiple(pool_map, entry->start, DIV_ROUND_UP(entry->len, ZSWAP_UNIT), false);
+	bitmap_reset(entry_map, index);
+}
+
+void zswap_print_stats(void)
+{
+	long long ratio = bytes_out != 0 ? bytes_in * 100 / bytes_out : 0;
+
+	printf("Compressed swap: %lld pages stored (%lld same filled), %lld loaded, "
+	       "%lld incompressible, %lld pool full\n",
+	       store_cnt, same_filled_cnt, load_cnt, reject_cnt, full_cnt);
+	if(bytes_out != 0)
+		printf("Compressed swap: %lld bytes into %lld, ratio %lld.%02lld\n",
+		       bytes_in, bytes_out, ratio / 100, ratio % 100);
+}
+
+/* return true if page consists of one repeated word */
+static bool same_filled(const uint32_t *page, uint32_t *fill)
+{
+	size_t i;
+
+	for(i = 1; i < PGSIZE / sizeof *page; i++)
+		if(page[i] != page[0])
+			return false;
+	*fill = page[0];
+	return true;
+}
+
+/* run-length encode page SRC into DST.
+   control byte 0x80|n is followed by a byte repeated n+ZSWAP_MIN_RUN
+   times, control byte n < 0x80 is followed by n+1 literal bytes.
+   return compressed length, or 0 if longer than ZSWAP_MAX_SIZE */
+static size_t compress_page(const uint8_t *src, uint8_t *dst)
+{
+	size_t in = 0;
+	size_t out = 0;
+	size_t run;
+	size_t literal;
+
+	while(in < PGSIZE)
+	{
+		run = 1;
+		while(in + run < PGSIZE && run < ZSWAP_MAX_RUN && src[in + run] == src[in])
+			run++;
+		if(run >= ZSWAP_MIN_RUN)
+		{
+			if(out + 2 > ZSWAP_MAX_SIZE)
+				return 0;
+			dst[out++] = 0x80 | (run - ZSWAP_MIN_RUN);
+			dst[out++] = src[in];
+			in += run;
+			continue;
+		}
+		/* copy literal bytes until next run starts */
+		literal = 0;
+		while(in + literal < PGSIZE && literal < ZSWAP_MAX_LITERAL)
+		{
+			if(in + literal + 2 < PGSIZE && src[in + literal] == src[in + literal + 1]
+			   && src[in + literal] == src[in + literal + 2])
+				break;
+			literal++;
+		}
+		if(out + 1 + literal > ZSWAP_MAX_SIZE)
+			return 0;
+		dst[out++] = literal - 1;
+		memcpy(dst + out, src + in, literal);
+		out += literal;
+		in += literal;
+	}
+	return out;
+}
+
+static void decompress_page(const uint8_t *src, uint8_t *dst)
+{
+	size_t out = 0;
+	size_t n;
+
+	while(out < PGSIZE)
+	{
+		if(*src & 0x80)
+		{
+			n = (*src++ & 0x7f) + ZSWAP_MIN_RUN;
+			memset(dst + out, *src++, n);
+		}
+		else
+		{
+			n = *src++ + 1;
+			memcpy(dst + out, src, n);
+			src += n;
+		}
+		out += n;
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* swap slots of compressed pages kept in memory have this bit set */
+#define ZSWAP_SLOT 0x80000000
+#define ZSWAP_PAGES 32                /* kernel pages in compressed pool */
+#define ZSWAP_ENTRIES 1024            /* max compressed pages in pool */
+
+void zswap_init(void);
+size_t zswap_store(void *kaddr);
+void zswap_load(size_t index, void *kaddr);
+void zswap_dup(size_t index);
+void zswap_free(size_t index);
+void zswap_print_stats(void);
+#endif
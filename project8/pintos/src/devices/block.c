@@ -3,8 +3,13 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
+/* Request latencies are counted in power-of-2 buckets: bucket K
+   counts latencies of 2**K to 2**(K+1) - 1 cycles. */
+#define LATENCY_BUCKETS 40
+
 /* A block device. */
 struct block
   {
@@ -19,6 +24,7 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long latency[LATENCY_BUCKETS]; /* Request latencies. */
   };
 
 /* List of all block devices. */
@@ -29,6 +35,15 @@ static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
 
+/* Returns the CPU's time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Returns a human-readable name for the given block device
    TYPE. */
 const char *
@@ -113,6 +128,98 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Initializes request R to transfer CNT sectors starting at
+   SECTOR between the device and BUFFER, writing to the device if
+   WRITE is true.  The request completes by upping its semaphore;
+   set R->complete afterward to be called back instead. */
+void
+block_request_init (struct block_request *r, block_sector_t sector,
+                    size_t cnt, void *buffer, bool write)
+{
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->complete = NULL;
+  r->aux = NULL;
+  sema_init (&r->done, 0);
+  r->block = NULL;
+}
+
+/* Submits request R to BLOCK and returns, possibly before R
+   completes.  Requests may complete in any order. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  size_t i;
+
+  ASSERT (r->cnt > 0 && r->cnt <= BLOCK_REQUEST_MAX);
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  if (r->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += r->cnt;
+    }
+  else
+    block->read_cnt += r->cnt;
+
+  /* Time the request against the device it was submitted to,
+     not the one a partition forwards it to. */
+  if (r->block == NULL)
+    {
+      r->block = block;
+      r->start = rdtsc ();
+    }
+
+  if (block->ops->submit != NULL)
+    {
+      block->ops->submit (block->aux, r);
+      return;
+    }
+
+  /* The driver has no queue, so do it now. */
+  for (i = 0; i < r->cnt; i++)
+    {
+      uint8_t *buffer = (uint8_t *) r->buffer + i * BLOCK_SECTOR_SIZE;
+      if (r->write)
+        block->ops->write (block->aux, r->sector + i, buffer);
+      else
+        block->ops->read (block->aux, r->sector + i, buffer);
+    }
+  block_request_done (r);
+}
+
+/* Waits for request R, which must not have a completion
+   function, to complete. */
+void
+block_request_wait (struct block_request *r)
+{
+  ASSERT (r->complete == NULL);
+  sema_down (&r->done);
+}
+
+/* Called by a driver when request R has completed.  May be
+   called from an interrupt handler. */
+void
+block_request_done (struct block_request *r)
+{
+  uint64_t latency = rdtsc () - r->start;
+  enum intr_level old_level;
+  int k;
+
+  for (k = 0; k < LATENCY_BUCKETS - 1 && latency >> (k + 1) != 0; k++)
+    continue;
+  old_level = intr_disable ();
+  r->block->latency[k]++;
+  intr_set_level (old_level);
+
+  if (r->complete != NULL)
+    r->complete (r);
+  else
+    sema_up (&r->done);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +227,11 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  struct block_request r;
+
+  block_request_init (&r, sector, 1, buffer, false);
+  block_submit (block, &r);
+  block_request_wait (&r);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +242,11 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  struct block_request r;
+
+  block_request_init (&r, sector, 1, (void *) buffer, true);
+  block_submit (block, &r);
+  block_request_wait (&r);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -171,9 +281,15 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
+          int k;
+
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          for (k = 0; k < LATENCY_BUCKETS; k++)
+            if (block->latency[k] != 0)
+              printf ("  latency %llu-%llu cycles: %llu requests\n",
+                      1ULL << k, (1ULL << (k + 1)) - 1, block->latency[k]);
         }
     }
 }
@@ -200,6 +316,7 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  memset (block->latency, 0, sizeof block->latency);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
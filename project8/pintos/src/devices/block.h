@@ -2,7 +2,10 @@
 #define DEVICES_BLOCK_H
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -58,17 +61,53 @@ enum block_type block_type (struct block *);
 
 /* Statistics. */
 void block_print_stats (void);
+
+/* Asynchronous requests.
+
+   A request transfers CNT consecutive sectors starting at SECTOR
+   between the device and BUFFER.  The submitter owns the request
+   and its buffer until it completes. */
+struct block_request
+  {
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                 /* True to write, false to read. */
+
+    /* Called on completion, possibly from an interrupt handler,
+       so it must not sleep.  If null, DONE is up'd instead. */
+    void (*complete) (struct block_request *);
+    void *aux;                  /* For use by COMPLETE. */
+    struct semaphore done;      /* Up'd on completion if COMPLETE is null. */
+
+    struct list_elem elem;      /* Owned by the driver while queued. */
+    struct block *block;        /* Device first submitted to. */
+    uint64_t start;             /* Time of submission, in TSC cycles. */
+  };
+
+/* Most sectors in one request. */
+#define BLOCK_REQUEST_MAX 64
+
+void block_request_init (struct block_request *, block_sector_t,
+                         size_t cnt, void *buffer, bool write);
+void block_submit (struct block *, struct block_request *);
+void block_request_wait (struct block_request *);
 
-/* Lower-level interface to block device drivers. */
+/* Lower-level interface to block device drivers.
+   A driver that queues requests provides SUBMIT, and calls
+   block_request_done() when each one finishes.  Otherwise
+   requests are carried out synchronously with READ and WRITE. */
 
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_request_done (struct block_request *);
 
 #endif /* devices/block.h */
@@ -1,6 +1,7 @@
 #include "devices/ide.h"
 #include <ctype.h>
 #include <debug.h>
+#include <round.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/block.h"
@@ -9,6 +10,8 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -30,10 +33,36 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's bus
+   master base. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_START 0x01           /* Start/stop bus master transfer. */
+#define BM_READ 0x08            /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_ACTIVE 0x01          /* Transfer in progress. */
+#define BM_ERROR 0x02           /* Transfer failed (write 1 to clear). */
+#define BM_INTR 0x04            /* Interrupt raised (write 1 to clear). */
+
+/* PCI configuration space access ("mechanism #1"). */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+#define PCI_REG_ID 0x00         /* Device and vendor ID. */
+#define PCI_REG_COMMAND 0x04    /* Command and status. */
+#define PCI_REG_CLASS 0x08      /* Class code and revision. */
+#define PCI_REG_BAR4 0x20       /* Base address register 4. */
+#define PCI_CMD_IO 0x0001       /* I/O space enable. */
+#define PCI_CMD_MASTER 0x0004   /* Bus master enable. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +78,35 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* A physical region descriptor: one physically contiguous piece
+   of a bus master transfer.  The region must not cross a 64 kB
+   boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address of region. */
+    uint16_t size;              /* Size in bytes, 0 means 64 kB. */
+    uint16_t flags;             /* PRD_EOT on last descriptor. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Descriptors per channel.  Each request in a transfer needs one
+   descriptor per page its buffer touches. */
+#define PRD_CNT 32
+
+/* Most sectors moved by one merged transfer. */
+#define TRANSFER_MAX 128
+
+/* How a channel's current transfer moves data. */
+enum transfer_mode
+  {
+    XFER_NONE,                  /* No transfer in progress. */
+    XFER_DMA,                   /* Bus master DMA. */
+    XFER_PIO_IN,                /* PIO from disk to memory. */
+    XFER_PIO_OUT                /* PIO from memory to disk. */
+  };
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +115,10 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool use_dma;               /* Transfer with bus master DMA? */
+
+    struct list queue;          /* Pending requests, sorted by sector. */
+    block_sector_t cursor;      /* Sector just past the last transfer. */
   };
 
 /* An ATA channel (aka controller).
@@ -67,12 +129,30 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
+    struct lock lock;           /* Protects the devices' queues. */
+    struct condition queued;    /* Signaled when a request is queued. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
+    int last_dev;               /* Device served by the last transfer. */
+
+    int selected_dev;           /* Device last selected, -1 if unknown. */
+
+    /* Transfer in progress.  The dispatcher thread starts it and
+       the interrupt handler moves it along and completes it. */
+    struct list active;         /* Requests being transferred. */
+    enum transfer_mode mode;    /* How ACTIVE is being transferred. */
+    struct list_elem *pio_req;  /* PIO: request of the next sector. */
+    size_t pio_ofs;             /* PIO: next sector within PIO_REQ. */
+
+    uint16_t bm_base;           /* Bus master base port, 0 if none. */
+    struct prd prdt[PRD_CNT]
+      __attribute__ ((aligned (PRD_CNT * sizeof (struct prd))));
+                                /* PRD table for bus master transfers.
+                                   Aligned to its size so that it
+                                   does not cross a 64 kB boundary. */
   };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
@@ -85,7 +165,9 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static uint16_t find_bus_master (void);
+static void dispatcher (void *channel_);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -101,6 +183,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -124,8 +207,14 @@ ide_init (void)
           NOT_REACHED ();
         }
       lock_init (&c->lock);
+      cond_init (&c->queued);
       c->expecting_interrupt = false;
+      c->last_dev = 0;
+      c->selected_dev = -1;
+      list_init (&c->active);
+      c->mode = XFER_NONE;
       sema_init (&c->completion_wait, 0);
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +225,9 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->use_dma = false;
+          list_init (&d->queue);
+          d->cursor = 0;
         }
 
       /* Register interrupt handler. */
@@ -148,6 +240,11 @@ ide_init (void)
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
 
+      /* Start serving requests, which scanning the partition
+         tables of disks below already needs. */
+      if (c->devices[0].is_ata || c->devices[1].is_ata)
+        thread_create (c->name, PRI_DEFAULT, dispatcher, c);
+
       /* Read hard disk identity information. */
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
@@ -155,6 +252,61 @@ ide_init (void)
     }
 }
 
+/* PCI bus master detection. */
+
+/* Reads 32-bit register REG of PCI function FUNC of device DEV
+   on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to 32-bit register REG of PCI function FUNC of
+   device DEV on bus 0. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) 
+{
+  outl (PCI_CONFIG_ADDRESS, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks for a PCI IDE controller capable of bus mastering, such
+   as the PIIX that QEMU emulates, and enables it as a bus master.
+   Returns its bus master base port, or 0 if there is none, in
+   which case all transfers use PIO. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++) 
+      {
+        uint32_t class, bar;
+
+        if ((pci_read_config (dev, func, PCI_REG_ID) & 0xffff) == 0xffff)
+          continue;
+
+        /* Mass storage (0x01), IDE (0x01), bus master capable
+           (bit 7 of the programming interface). */
+        class = pci_read_config (dev, func, PCI_REG_CLASS);
+        if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+          continue;
+
+        bar = pci_read_config (dev, func, PCI_REG_BAR4);
+        if ((bar & 1) == 0 || (bar & ~3u) == 0)
+          continue;
+
+        pci_write_config (dev, func, PCI_REG_COMMAND,
+                          pci_read_config (dev, func, PCI_REG_COMMAND)
+                          | PCI_CMD_IO | PCI_CMD_MASTER);
+        return bar & ~3u;
+      }
+  return 0;
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -286,8 +438,11 @@ identify_ata_device (struct ata_disk *d)
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+  /* Use DMA if both the controller and the disk support it. */
+  d->use_dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->use_dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -337,63 +492,324 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+/* Request queueing and dispatch. */
+
+/* Orders requests by starting sector. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED) 
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Queues request R for disk D.  D's channel's dispatcher thread
+   carries it out later.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_submit (void *d_, struct block_request *r)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  list_insert_ordered (&d->queue, &r->elem, request_less, NULL);
+  cond_signal (&c->queued, &c->lock);
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
-    ide_read,
-    ide_write
+    NULL,
+    NULL,
+    ide_submit
   };
-
-/* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+
+/* Returns true if R's buffer can be transferred by DMA on D. */
+static bool
+dma_ok (const struct ata_disk *d, const struct block_request *r) 
+{
+  return (d->use_dma
+          && is_kernel_vaddr (r->buffer)
+          && ((uintptr_t) r->buffer & 1) == 0);
+}
+
+/* Returns the number of PRDs that R's buffer needs. */
+static size_t
+prd_need (const struct block_request *r) 
+{
+  size_t size = r->cnt * BLOCK_SECTOR_SIZE;
+  return DIV_ROUND_UP (pg_ofs (r->buffer) + size, PGSIZE);
+}
+
+/* Chooses the next transfer for channel C, moving its requests
+   from their disk's queue to C->active, and returns the disk.
+   The disks of a channel take turns.  Each disk's queue is served
+   C-SCAN style: the request at or after the disk's cursor with
+   the lowest sector goes first, wrapping around to the lowest
+   sector overall, and following requests for adjacent sectors
+   in the same direction are merged into the transfer.  Returns
+   a null pointer if no request is queued.  C's lock must be
+   held. */
+static struct ata_disk *
+pick_transfer (struct channel *c) 
+{
+  struct ata_disk *d = NULL;
+  struct list_elem *e;
+  struct block_request *first;
+  block_sector_t end;
+  size_t cnt, prds;
+  bool dma;
+  int i;
+
+  for (i = 1; i <= 2; i++) 
+    {
+      struct ata_disk *cand = &c->devices[(c->last_dev + i) % 2];
+      if (!list_empty (&cand->queue))
+        {
+          d = cand;
+          break;
+        }
+    }
+  if (d == NULL)
+    return NULL;
+  c->last_dev = d->dev_no;
+
+  for (e = list_begin (&d->queue); e != list_end (&d->queue);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector >= d->cursor)
+      break;
+  if (e == list_end (&d->queue))
+    e = list_begin (&d->queue);
+
+  first = list_entry (e, struct block_request, elem);
+  dma = dma_ok (d, first);
+  cnt = prds = 0;
+  end = first->sector;
+  while (e != list_end (&d->queue)) 
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector != end || r->write != first->write
+          || dma_ok (d, r) != dma
+          || cnt + r->cnt > TRANSFER_MAX
+          || (dma && prds + prd_need (r) > PRD_CNT))
+        break;
+      e = list_remove (e);
+      list_push_back (&c->active, &r->elem);
+      end += r->cnt;
+      cnt += r->cnt;
+      prds += prd_need (r);
+    }
+  d->cursor = end;
+  return d;
+}
+
+/* Starts a DMA transfer of the requests in C->active, which are
+   for consecutive sectors of disk D.  The interrupt handler
+   completes them with a single interrupt. */
+static void
+start_dma (struct ata_disk *d) 
+{
+  struct channel *c = d->channel;
+  struct block_request *first
+    = list_entry (list_front (&c->active), struct block_request, elem);
+  bool write = first->write;
+  size_t prd_cnt = 0, cnt = 0;
+  struct list_elem *e;
+
+  /* Describe each buffer one page at a time, since consecutive
+     virtual pages are not always physically contiguous. */
+  for (e = list_begin (&c->active); e != list_end (&c->active);
+       e = list_next (e)) 
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      uint8_t *p = r->buffer;
+      size_t left = r->cnt * BLOCK_SECTOR_SIZE;
+
+      while (left > 0) 
+        {
+          size_t chunk = PGSIZE - pg_ofs (p);
+          if (chunk > left)
+            chunk = left;
+          c->prdt[prd_cnt].addr = vtop (p);
+          c->prdt[prd_cnt].size = chunk;
+          c->prdt[prd_cnt].flags = 0;
+          prd_cnt++;
+          p += chunk;
+          left -= chunk;
+        }
+      cnt += r->cnt;
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+  /* Load the table, clear stale status, set the direction, issue
+     the command, and then start the bus master. */
+  c->mode = XFER_DMA;
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_status (c), BM_ERROR | BM_INTR);
+  outb (reg_bm_command (c), write ? 0 : BM_READ);
+  select_sector (d, first->sector, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), (write ? 0 : BM_READ) | BM_START);
+}
+
+/* Completes the requests of channel C's transfer, which has
+   finished. */
+static void
+complete_transfer (struct channel *c) 
+{
+  c->mode = XFER_NONE;
+  while (!list_empty (&c->active))
+    block_request_done (list_entry (list_pop_front (&c->active),
+                                    struct block_request, elem));
+}
+
+/* Called by the interrupt handler when the DMA transfer on
+   channel C finishes. */
+static void
+finish_dma (struct channel *c, uint8_t status) 
+{
+  uint8_t bm_status;
+
+  outb (reg_bm_command (c), 0);
+  bm_status = inb (reg_bm_status (c));
+  if ((bm_status & BM_ERROR) || (status & STA_ERR))
+    PANIC ("%s: DMA transfer failed", c->name);
+  complete_transfer (c);
+}
+
+/* Returns the buffer for the next PIO sector of channel C. */
+static void *
+pio_buffer (struct channel *c) 
+{
+  struct block_request *r = list_entry (c->pio_req, struct block_request,
+                                        elem);
+  return (uint8_t *) r->buffer + c->pio_ofs * BLOCK_SECTOR_SIZE;
+}
+
+/* Advances channel C's PIO transfer past one sector.  Returns
+   false if that was the last sector. */
+static bool
+pio_advance (struct channel *c) 
+{
+  struct block_request *r = list_entry (c->pio_req, struct block_request,
+                                        elem);
+  if (++c->pio_ofs < r->cnt)
+    return true;
+  c->pio_req = list_next (c->pio_req);
+  c->pio_ofs = 0;
+  return c->pio_req != list_end (&c->active);
+}
+
+/* Starts a PIO transfer of the requests in C->active, which are
+   for consecutive sectors of disk D.  The interrupt handler moves
+   each further sector and completes the requests. */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+start_pio (struct ata_disk *d) 
+{
+  struct channel *c = d->channel;
+  struct block_request *first
+    = list_entry (list_front (&c->active), struct block_request, elem);
+  bool write = first->write;
+  size_t cnt = 0;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->active); e != list_end (&c->active);
+       e = list_next (e))
+    cnt += list_entry (e, struct block_request, elem)->cnt;
+
+  c->mode = write ? XFER_PIO_OUT : XFER_PIO_IN;
+  c->pio_req = list_begin (&c->active);
+  c->pio_ofs = 0;
+  select_sector (d, first->sector, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_SECTOR_RETRY
+                              : CMD_READ_SECTOR_RETRY);
+
+  /* The disk interrupts once a sector has been read, and once a
+     sector has been written, but not before the first sector of
+     a write.  That one we send as soon as the disk asks for it,
+     which is almost at once. */
+  if (write) 
+    {
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu,
+               d->name, first->sector);
+      output_sector (c, pio_buffer (c));
+    }
+}
+
+/* Called by the interrupt handler for each interrupt during the
+   PIO transfer on channel C, whose status register read STATUS.
+   Moves the next sector and returns false, or returns true if
+   the transfer is complete. */
+static bool
+pio_interrupt (struct channel *c, uint8_t status) 
+{
+  if (status & STA_ERR)
+    PANIC ("%s: PIO transfer failed", c->name);
+
+  if (c->mode == XFER_PIO_IN) 
+    {
+      if ((status & (STA_BSY | STA_DRQ)) != STA_DRQ)
+        PANIC ("%s: disk read failed", c->name);
+      input_sector (c, pio_buffer (c));
+      if (pio_advance (c))
+        return false;
+    }
+  else if (pio_advance (c)) 
+    {
+      output_sector (c, pio_buffer (c));
+      return false;
+    }
+
+  complete_transfer (c);
+  return true;
+}
+
+/* Dispatcher thread for channel C_, which owns the controller
+   and carries out queued requests one transfer at a time. */
+static void
+dispatcher (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;) 
+    {
+      struct ata_disk *d;
+      struct block_request *first;
+
+      lock_acquire (&c->lock);
+      while ((d = pick_transfer (c)) == NULL)
+        cond_wait (&c->queued, &c->lock);
+      lock_release (&c->lock);
+
+      first = list_entry (list_front (&c->active), struct block_request, elem);
+      if (dma_ok (d, first))
+        start_dma (d);
+      else
+        start_pio (d);
+      sema_down (&c->completion_wait);
+    }
+}
+
+/* Selects device D, if it is not selected already, and then
+   writes the CNT sectors starting at SEC_NO to the disk's sector
+   selection registers.  (We use LBA mode.)  D's channel must be
+   idle, as it is between transfers. */
+static void
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= 256);
   
-  select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  if (c->selected_dev != d->dev_no)
+    select_device (d);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -487,6 +903,7 @@ select_device (const struct ata_disk *d)
   uint8_t dev = DEV_MBS;
   if (d->dev_no == 1)
     dev |= DEV_DEV;
+  c->selected_dev = d->dev_no;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
   timer_nsleep (400);
@@ -513,7 +930,13 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
-            inb (reg_status (c));               /* Acknowledge interrupt. */
+            uint8_t status = inb (reg_status (c)); /* Acknowledge. */
+            if (c->bm_base != 0)
+              outb (reg_bm_status (c), BM_INTR);
+            if (c->mode == XFER_DMA)
+              finish_dma (c, status);
+            else if (c->mode != XFER_NONE && !pio_interrupt (c, status))
+              return;                           /* More sectors to go. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
@@ -0,0 +1,107 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in kernel memory.  It costs no emulated
+   device time, so file system and VM benchmarks run on it
+   measure only the software above the block layer.  Its
+   contents are lost at shutdown. */
+
+/* Sectors per page of RAM disk memory. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk.  The memory is kept in separate pages, so that a
+   large disk does not need physically contiguous memory. */
+struct ramdisk
+  {
+    size_t page_cnt;            /* Number of pages. */
+    uint8_t **pages;            /* The pages. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Returns the address of SECTOR in RD. */
+static uint8_t *
+sector_addr (struct ramdisk *rd, block_sector_t sector)
+{
+  return (rd->pages[sector / SECTORS_PER_PAGE]
+          + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+}
+
+/* Creates a RAM disk named "ram0" of SECTORS sectors, which may
+   then be given a role with -filesys=ram0 or -swap=ram0.  If
+   IMAGE is non-null, the RAM disk is filled with the contents of
+   the block device of that name, and if SECTORS is 0 it is as
+   large as that device.  Otherwise it starts out zeroed. */
+void
+ramdisk_init (size_t sectors, const char *image)
+{
+  struct block *source = NULL;
+  char extra_info[32];
+  struct ramdisk *rd;
+  block_sector_t sector, copy_cnt = 0;
+  size_t i;
+
+  if (image != NULL)
+    {
+      source = block_get_by_name (image);
+      if (source == NULL)
+        PANIC ("No such block device \"%s\"", image);
+      if (sectors == 0)
+        sectors = block_size (source);
+      copy_cnt = block_size (source) < sectors ? block_size (source) : sectors;
+    }
+  if (sectors == 0)
+    return;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("ram0: out of memory");
+  rd->page_cnt = DIV_ROUND_UP (sectors, SECTORS_PER_PAGE);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("ram0: out of memory");
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("ram0: out of memory for %zu sectors", sectors);
+    }
+
+  for (sector = 0; sector < copy_cnt; sector++)
+    block_read (source, sector, sector_addr (rd, sector));
+
+  if (image != NULL)
+    snprintf (extra_info, sizeof extra_info, "copy of %s", image);
+  block_register ("ram0", BLOCK_RAW, image != NULL ? extra_info : NULL,
+                  sectors, &ramdisk_operations, rd);
+}
+
+/* Reads sector SECTOR from RAM disk RD_ into BUFFER. */
+static void
+ramdisk_read (void *rd_, block_sector_t sector, void *buffer)
+{
+  struct ramdisk *rd = rd_;
+  memcpy (buffer, sector_addr (rd, sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR to RAM disk RD_ from BUFFER. */
+static void
+ramdisk_write (void *rd_, block_sector_t sector, const void *buffer)
+{
+  struct ramdisk *rd = rd_;
+  memcpy (sector_addr (rd, sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    NULL
+  };
@@ -12,6 +12,8 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "filesys/buffer_cache.h"
 #endif
 
 /* Keyboard control register port. */
@@ -122,6 +124,8 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  inode_print_stats ();
+  bc_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
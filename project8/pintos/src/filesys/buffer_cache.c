@@ -1,6 +1,7 @@
 #include <threads/malloc.h>
 #include <stdio.h>
 #include <string.h>
+#include <round.h>
 #include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
@@ -9,18 +10,43 @@
 void *p_buffer_cache;   
 /* Array of struct buffer_head.*/
 struct buffer_head head_buffer[BUFFER_CACHE_ENTRY_NB];
-/* This value is made for clock Algorithm */
-int clock_hand;
+/* 2Q replacement. a sector read once waits in a1in (FIFO).
+   a sector referenced again after leaving a1in, or a metadata
+   sector, lives in am (LRU, most recent first), so a long scan only
+   cycles through a1in and can't flush the hot sectors in am. */
+static struct list a1in;
+static struct list am;
+static size_t a1in_cnt;
+/* number of cached metadata sectors */
+static size_t meta_cnt;
+/* a1out remembers sectors recently evicted from a1in */
+static block_sector_t a1out[A1OUT_SIZE];
+static int a1out_head;
+static int a1out_cnt;
+/* protects buffer cache. disk I/O runs without it, on a busy entry */
+static struct lock bc_lock;
+/* signaled when an entry stops being busy */
+static struct condition bc_io_done;
+/* statistics */
+static unsigned long long bc_hit_cnt;
+static unsigned long long bc_miss_cnt;
+static unsigned long long bc_evict_clean_cnt;
+static unsigned long long bc_evict_dirty_cnt;
+static unsigned long long bc_write_back_cnt;
 
 
 static void locate_byte(off_t pos, struct sector_location *sec_loc);
 static inline off_t map_table_offset(int index);
 static bool register_sector(struct inode_disk *inode_disk, block_sector_t new_sector, struct sector_location sec_loc);
+static bool allocate_sector(struct prealloc_window *window, block_sector_t goal, size_t need, block_sector_t *sectorp);
+static struct buffer_head *bc_get(block_sector_t sector, bool meta);
+static bool a1out_remove(block_sector_t sector);
+static void a1out_add(block_sector_t sector);
 
 /* get disk from inode */
 bool get_disk_inode(const struct inode *inode, struct inode_disk *inode_disk)
 {
-	bc_read(inode->sector,(void *)inode_disk, 0, SECTOR_SIZE, 0);
+	bc_read(inode->sector,(void *)inode_disk, 0, SECTOR_SIZE, 0, true);
 	return true;
 }
 /* */
@@ -66,9 +92,21 @@ static inline off_t map_table_offset(int index)
 {
 	return index*4;
 }
-/* update new disk block number to inode_disk */
+/* allocate an index block filled with zeros, so its entries are holes */
+static bool allocate_index_block(block_sector_t *sectorp)
+{
+	static char zeros[SECTOR_SIZE];
+	if(free_map_allocate(1, sectorp) == false)
+		return false;
+	bc_write(*sectorp, zeros, 0, SECTOR_SIZE, 0, true);
+	return true;
+}
+/* update new disk block number to inode_disk.
+   index blocks are allocated when first needed, so a file may have holes */
 static bool register_sector(struct inode_disk *inode_disk, block_sector_t new_sector, struct sector_location sec_loc)
 {
+	block_sector_t index_sec;
+
 	switch(sec_loc.directness)
 	{
 		case NORMAL_DIRECT:
@@ -76,62 +114,32 @@ static bool register_sector(struct inode_disk *inode_disk, block_sector_t new_se
 			inode_disk->direct_map_table[sec_loc.index1] = new_sector;
 			break;
 		case INDIRECT:
-			/* if use indirect first, allocate disk for indirect index block */
-			if(sec_loc.index1 == 0)
+			/* allocate disk for indirect index block on first use */
+			if(inode_disk->indirect_block_sec == 0)
 			{
-				block_sector_t sector_idx;
-				if(free_map_allocate(1, &sector_idx))
-					inode_disk->indirect_block_sec = sector_idx;
+				if(allocate_index_block(&inode_disk->indirect_block_sec) == false)
+					return false;
 			}
-			/* allocate new_block and write new_sector to new_block */
-			block_sector_t *new_block = (block_sector_t *)malloc(SECTOR_SIZE);
-			if(new_block == NULL)
-				return false;
-			new_block[sec_loc.index1] = new_sector;
-			/* write new_block to index block */
-	   bc_write(inode_disk->indirect_block_sec, (void *)new_block,map_table_offset(sec_loc.index1) ,4 ,map_table_offset(sec_loc.index1));
-            free(new_block);
+			/* write new_sector to index block */
+			bc_write(inode_disk->indirect_block_sec, (void *)&new_sector, 0, 4, map_table_offset(sec_loc.index1), true);
 			break;
 		case DOUBLE_INDIRECT:
-			/* if index1 and index2 is 0, allocate disk for index block 1 */
-			if(sec_loc.index1 == 0 && sec_loc.index2 ==0)
+			/* allocate disk for index block 1 on first use */
+			if(inode_disk->double_indirect_block_sec == 0)
 			{
-				block_sector_t sector_idx;
-				if(free_map_allocate(1, &sector_idx))
-					inode_disk->double_indirect_block_sec = sector_idx;
+				if(allocate_index_block(&inode_disk->double_indirect_block_sec) == false)
+					return false;
 			}
-			/* if index2 is 0, allocate disk for index block 2 and update index block 1 */
-			if(sec_loc.index2 == 0 )
+			/* find index block 2, allocate it and update index block 1 if not exist */
+			bc_read(inode_disk->double_indirect_block_sec, (void *)&index_sec, 0, 4, map_table_offset(sec_loc.index1), true);
+			if(index_sec == 0)
 			{
-				/* allocate disk for index block 2 */
-				block_sector_t sector_idx;
-				if(free_map_allocate(1, &sector_idx) == false)
+				if(allocate_index_block(&index_sec) == false)
 					return false;
-				/* update index block 1*/
-				block_sector_t *new_block = (block_sector_t *)malloc(SECTOR_SIZE);
-				if(new_block == NULL)
-					return false;
-				new_block[sec_loc.index1] = sector_idx;
-				bc_write(inode_disk->double_indirect_block_sec, (void *)new_block, sec_loc.index1 * 4, 4, sec_loc.index1 * 4);
-				free(new_block);
+				bc_write(inode_disk->double_indirect_block_sec, (void *)&index_sec, 0, 4, map_table_offset(sec_loc.index1), true);
 			}
 			/* update index block 2 */
-			/* Value for read index_block 1 */
-			block_sector_t *index_block1 = (block_sector_t *)malloc(SECTOR_SIZE);
-			if(index_block1 == NULL)
-				return false;
-			/* Value for update index_block 2 */
-			block_sector_t *new_block2    = (block_sector_t *)malloc(SECTOR_SIZE);
-			if(new_block2 == NULL)
-				return false;
-			/* read index block 1 */
-			bc_read(inode_disk->double_indirect_block_sec, (void *)index_block1, 0, SECTOR_SIZE, 0);
-			block_sector_t block_sector = index_block1[sec_loc.index1];
-			/* update index block 2*/
-			new_block2[sec_loc.index2] = new_sector;
-			bc_write(block_sector, (void *)new_block2, sec_loc.index2 * 4, 4, sec_loc.index2 * 4);
-			free(new_block2);
-			free(index_block1);
+			bc_write(index_sec, (void *)&new_sector, 0, 4, map_table_offset(sec_loc.index2), true);
 			break;
 		default:
 			return false;
@@ -162,10 +170,16 @@ block_sector_t byte_to_sector(const struct inode_disk *inode_disk, off_t pos)
 					/* read index1 block from disk */
 					if(ind_block != NULL)
 					{
-						/* read index block1 */
-						bc_read(inode_disk->indirect_block_sec, (void *)ind_block, 0, SECTOR_SIZE, 0);
-						/* get the disk sector_number, which located index1 */
-						result_sec = ind_block->map_table[sec_loc.index1];
+						/* index block not allocated, hole */
+						if(inode_disk->indirect_block_sec == 0)
+							result_sec = 0;
+						else
+						{
+							/* read index block1 */
+							bc_read(inode_disk->indirect_block_sec, (void *)ind_block, 0, SECTOR_SIZE, 0, true);
+							/* get the disk sector_number, which located index1 */
+							result_sec = ind_block->map_table[sec_loc.index1];
+						}
 						free(ind_block);
 					}
 					else
@@ -177,16 +191,24 @@ block_sector_t byte_to_sector(const struct inode_disk *inode_disk, off_t pos)
 					/* read index block1 and index block2 from disk. and get disk block number */
 					if(ind_block != NULL && second_ind_block != NULL)
 					{
-						/* read index block1 */
-						bc_read(inode_disk->double_indirect_block_sec, (void *)ind_block, 0, SECTOR_SIZE, 0);
-						/* read_index block2 */
-						bc_read(ind_block->map_table[sec_loc.index1] ,(void *)second_ind_block, 0, SECTOR_SIZE, 0);
-						result_sec = second_ind_block->map_table[sec_loc.index2];
-						free(ind_block);
-						free(second_ind_block);
+						result_sec = 0;
+						/* missing index blocks are holes */
+						if(inode_disk->double_indirect_block_sec != 0)
+						{
+							/* read index block1 */
+							bc_read(inode_disk->double_indirect_block_sec, (void *)ind_block, 0, SECTOR_SIZE, 0, true);
+							/* read_index block2 */
+							if(ind_block->map_table[sec_loc.index1] != 0)
+							{
+								bc_read(ind_block->map_table[sec_loc.index1] ,(void *)second_ind_block, 0, SECTOR_SIZE, 0, true);
+								result_sec = second_ind_block->map_table[sec_loc.index2];
+							}
+						}
 					}
 					else
 						result_sec = 0;
+					free(ind_block);
+					free(second_ind_block);
 					break;
 			case OUT_LIMIT:
 					printf("OUT LIMIT!\n");
@@ -198,121 +220,142 @@ block_sector_t byte_to_sector(const struct inode_disk *inode_disk, off_t pos)
 		result_sec = 0;
 	return result_sec;
 }
-/* if offset is bigger than file_length, allocate new disk and update inode */
-bool inode_update_file_length(struct inode_disk *inode_disk, off_t start_pos, off_t end_pos)
+/* take a sector from window. if window is empty, reserve a run of
+   sectors right after goal, need for the file plus PREALLOC_SECTORS,
+   so the file grows physically sequential */
+static bool allocate_sector(struct prealloc_window *window, block_sector_t goal, size_t need, block_sector_t *sectorp)
+{
+	/* window not following the file's last sector is stale */
+	if(window->cnt > 0 && window->start != goal)
+		prealloc_release(window);
+	if(window->cnt == 0)
+	{
+		window->cnt = free_map_allocate_run(goal, need + PREALLOC_SECTORS, &window->start);
+		if(window->cnt == 0)
+			return false;
+	}
+	*sectorp = window->start;
+	window->start++;
+	window->cnt--;
+	return true;
+}
+/* give back the sectors reserved in window */
+void prealloc_release(struct prealloc_window *window)
+{
+	if(window->cnt > 0)
+		free_map_release(window->start, window->cnt);
+	window->cnt = 0;
+}
+/* allocate a zero filled disk block for the hole at pos and register it
+   to inode_disk. the block comes from window, following the block of
+   previous sector so the file stays contiguous. need is the number of
+   sectors the caller is about to write */
+bool inode_allocate_sector(struct inode_disk *inode_disk, off_t pos, size_t need, struct prealloc_window *window, block_sector_t *sectorp)
 {
-	off_t size = end_pos - start_pos;
-	off_t offset = start_pos;
-	void *zeros = malloc(SECTOR_SIZE);
-	int chunck_size;
-	/* make zeros */
-	if(zeros == NULL)
+	static char zeros[SECTOR_SIZE];
+	struct sector_location sec_loc;
+	block_sector_t goal = 0;
+	block_sector_t prev;
+
+	/* new sector should follow the previous sector of file */
+	if(pos >= SECTOR_SIZE)
+	{
+		prev = byte_to_sector(inode_disk, pos - SECTOR_SIZE);
+		if(prev != 0)
+			goal = prev + 1;
+	}
+	if(allocate_sector(window, goal, need, sectorp) == false)
 		return false;
-	memset(zeros, 0, SECTOR_SIZE);
-	while( size > 0 )
+	locate_byte(pos, &sec_loc);
+	if(register_sector(inode_disk, *sectorp, sec_loc) == false)
 	{
-		/* offset in the disk block */
-		int sector_ofs = offset % SECTOR_SIZE;
-		/* caculate chunck size */
-		if( size >= SECTOR_SIZE)
-			chunck_size = SECTOR_SIZE - sector_ofs;
-		else
-		{
-			if(sector_ofs + size > SECTOR_SIZE)
-				chunck_size = SECTOR_SIZE - sector_ofs;
-			else
-				chunck_size = size;
-		}
-		/* if sector_ofs is bigger than zero, already allocate disk block */
-		if(sector_ofs > 0 )
-		{
-		}
-		/* allocate new disk block */
-		else
+		free_map_release(*sectorp, 1);
+		return false;
+	}
+	/* init new disk block to 0 */
+	bc_write(*sectorp, zeros, 0, SECTOR_SIZE, 0, false);
+	return true;
+}
+/* convert inline file to block mapped file, moving its data
+   from the inode sector to a new disk block */
+bool inode_uninline(struct inode_disk *inode_disk, struct prealloc_window *window)
+{
+	uint8_t *data;
+	block_sector_t sector_idx;
+
+	data = malloc(INLINE_DATA_SIZE);
+	if(data == NULL)
+		return false;
+	memcpy(data, inode_disk->inline_data, INLINE_DATA_SIZE);
+	/* block map of empty file is all holes */
+	memset(inode_disk->inline_data, 0, INLINE_DATA_SIZE);
+	inode_disk->is_inline = false;
+	if(inode_disk->length > 0)
+	{
+		if(inode_allocate_sector(inode_disk, 0, 1, window, &sector_idx) == false)
 		{
-			struct sector_location sec_loc;
-			block_sector_t sector_idx;
-			/* allocate new disk block */
-			if(free_map_allocate(1, &sector_idx) == true)
-			{
-				/* update disk block number */
-				locate_byte(offset, &sec_loc);
-				register_sector(inode_disk, sector_idx, sec_loc);
-			}
-			else
-			{
-				free(zeros);
-				return false;
-			}
-			/* init new disk block to 0 */
-			bc_write(sector_idx, zeros, 0, SECTOR_SIZE, 0);
+			memcpy(inode_disk->inline_data, data, INLINE_DATA_SIZE);
+			inode_disk->is_inline = true;
+			free(data);
+			return false;
 		}
-		/* advance */
-		size   -= chunck_size;
-		offset += chunck_size;
+		bc_write(sector_idx, data, 0, inode_disk->length, 0, false);
 	}
-	free(zeros);
+	free(data);
 	return true;
 }
+/* free data blocks in index block at sector, skipping holes */
+static void free_index_block(block_sector_t sector)
+{
+	struct inode_indirect_block *index_block;
+	int i;
+
+	index_block = (struct inode_indirect_block *)malloc(SECTOR_SIZE);
+	if(index_block == NULL)
+		return;
+	bc_read(sector, (void *)index_block, 0, SECTOR_SIZE, 0, true);
+	for(i=0; i<INDIRECT_BLOCK_ENTRIES; i++)
+	{
+		if(index_block->map_table[i] != 0)
+			free_map_release(index_block->map_table[i], 1);
+	}
+	free(index_block);
+	free_map_release(sector, 1);
+}
 void free_inode_sectors(struct inode_disk *inode_disk)
 {
+	int i;
+
+	/* inline file has no disk block */
+	if(inode_disk->is_inline)
+		return;
+
 	/* double indirect block release */
-	if(inode_disk->double_indirect_block_sec > 0)
+	if(inode_disk->double_indirect_block_sec != 0)
 	{ 
-		/* read index block 1*/
-		int i = 0;
 		struct inode_indirect_block *index_block1;
 		index_block1 = (struct inode_indirect_block *)malloc(SECTOR_SIZE);
 		if(index_block1 == NULL)
 			return;
-		bc_read(inode_disk->double_indirect_block_sec, (void *)index_block1, 0, SECTOR_SIZE, 0);
-		/* approach index block 2(index i) by index block 1 */
-		while(index_block1->map_table[i] > 0)
+		bc_read(inode_disk->double_indirect_block_sec, (void *)index_block1, 0, SECTOR_SIZE, 0, true);
+		/* free every index block 2 and its disk blocks */
+		for(i=0; i<INDIRECT_BLOCK_ENTRIES; i++)
 		{
-			int j = 0;
-			struct inode_indirect_block *index_block2;
-			/* read index block 2 */
-			index_block2 = (struct inode_indirect_block *)malloc(SECTOR_SIZE);
-			if(index_block2 == NULL)
-				return;
-			bc_read(index_block1->map_table[i], (void *)index_block2, 0, SECTOR_SIZE, 0);
-			/* free disk block which stored in index block 2*/
-			while(index_block2->map_table[j] > 0)
-			{
-				free_map_release(index_block2->map_table[j], 1);
-				j++;
-			}
-			/* free index block 2*/
-			free_map_release(index_block1->map_table[i], 1);
-			i++;
+			if(index_block1->map_table[i] != 0)
+				free_index_block(index_block1->map_table[i]);
 		}
+		free(index_block1);
 		/* free index block 1 */
 		free_map_release(inode_disk->double_indirect_block_sec, 1);
 	}
 	/* indirect block release */
-	if(inode_disk->indirect_block_sec > 0 )
+	if(inode_disk->indirect_block_sec != 0)
+		free_index_block(inode_disk->indirect_block_sec);
+	/* free direct block release, skipping holes */
+	for(i=0; i<DIRECT_BLOCK_ENTRIES; i++)
 	{
-		int i = 0;
-		struct inode_indirect_block *index_block1;
-		index_block1 = (struct inode_indirect_block *)malloc(SECTOR_SIZE);
-		if(index_block1 == NULL)
-			return;
-		bc_read(inode_disk->indirect_block_sec, (void *)index_block1, 0, SECTOR_SIZE, 0);
-		/* free disk block which stored in index block 1 */
-		while(index_block1->map_table[i] > 0)
-		{
-			free_map_release(index_block1->map_table[i], 1);
-			i++;
-		}
-		/* free index block 1 */
-		free_map_release(inode_disk->indirect_block_sec, 1);
-	}
-	int i = 0;
-	/* free direct block release */
-	while(inode_disk->direct_map_table[i] > 0 )
-	{
-		free_map_release(inode_disk->direct_map_table[i], 1);
-		i++;
+		if(inode_disk->direct_map_table[i] != 0)
+			free_map_release(inode_disk->direct_map_table[i], 1);
 	}
 }
 /* allocating the buffer_cache memory and init the head_buffer */
@@ -326,37 +369,58 @@ void bc_init(void)
 		printf("allocating the buffer_cache is failed\n");
 		return;
 	}
+	/* initialize the queues */
+	list_init(&a1in);
+	list_init(&am);
+	a1in_cnt   = 0;
+	meta_cnt   = 0;
+	a1out_head = 0;
+	a1out_cnt  = 0;
+	lock_init(&bc_lock);
+	cond_init(&bc_io_done);
 	/* initialize the head_buffer */
-	clock_hand = 0;
 	for(i=0; i<BUFFER_CACHE_ENTRY_NB; i++)
 	{
 		head_buffer[i].dirty     = false;
 		head_buffer[i].is_used   = false;
-		head_buffer[i].clock_bit = false;
+		head_buffer[i].in_am     = false;
+		head_buffer[i].meta      = false;
+		head_buffer[i].busy      = false;
 		head_buffer[i].data      = p_buffer_cache + SECTOR_SIZE * i;
-		/* init lock valuable */
-		lock_init(&head_buffer[i].buffer_lock);
 	}
 }
 
-/* flush data from buffer cache to disk */
+/* flush data from buffer cache to disk. must hold bc_lock, which is
+   released while the entry is written */
 void bc_flush_entry(struct buffer_head *p_flush_entry)
 {
+	p_flush_entry->busy = true;
+	/* clear dirty first, a write during block_write dirties it again */
+	p_flush_entry->dirty = false;
+	lock_release(&bc_lock);
 	/* write data of buffer cache to disk */
 	block_write(fs_device, p_flush_entry->sector, p_flush_entry->data);
-	/* updata dirty value */
-	p_flush_entry->dirty = false;
+	lock_acquire(&bc_lock);
+	bc_write_back_cnt++;
+	p_flush_entry->busy = false;
+	cond_broadcast(&bc_io_done, &bc_lock);
 }
 
 /* flush all entries of */
 void bc_flush_all_entries(void)
 {
 	unsigned i;
+	/* write back free map changes together with the data */
+	free_map_flush();
+	lock_acquire(&bc_lock);
 	for(i=0; i<BUFFER_CACHE_ENTRY_NB; i++)
 	{
+		while(head_buffer[i].busy == true)
+			cond_wait(&bc_io_done, &bc_lock);
 		if(head_buffer[i].is_used == true && head_buffer[i].dirty == true)
 			bc_flush_entry(&head_buffer[i]);
 	}
+	lock_release(&bc_lock);
 }
 
 struct buffer_head* bc_lookup(block_sector_t sector)
@@ -373,43 +437,194 @@ struct buffer_head* bc_lookup(block_sector_t sector)
 	return NULL;
 }
 
+/* if sector is in a1out, remove it and return true */
+static bool a1out_remove(block_sector_t sector)
+{
+	int i, idx;
+	for(i=0; i<a1out_cnt; i++)
+	{
+		idx = (a1out_head + i) % A1OUT_SIZE;
+		if(a1out[idx] == sector)
+		{
+			/* fill the hole with the oldest sector */
+			a1out[idx] = a1out[a1out_head];
+			a1out_head = (a1out_head + 1) % A1OUT_SIZE;
+			a1out_cnt--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* remember sector evicted from a1in, forgetting the oldest if full */
+static void a1out_add(block_sector_t sector)
+{
+	if(a1out_cnt == A1OUT_SIZE)
+	{
+		a1out_head = (a1out_head + 1) % A1OUT_SIZE;
+		a1out_cnt--;
+	}
+	a1out[(a1out_head + a1out_cnt) % A1OUT_SIZE] = sector;
+	a1out_cnt++;
+}
+
+/* last entry of list, toward its front, that is not busy, or NULL */
+static struct buffer_head *last_idle(struct list *list)
+{
+	struct list_elem *e;
+	for(e = list_rbegin(list); e != list_rend(list); e = list_prev(e))
+	{
+		struct buffer_head *b = list_entry(e, struct buffer_head, elem);
+		if(b->busy == false)
+			return b;
+	}
+	return NULL;
+}
+
+/* choose entry to evict, skipping busy entries. the victim keeps its
+   sector and may be dirty. return NULL if every entry is busy.
+   must hold bc_lock */
 struct buffer_head* bc_select_victim(void)
 {
 	unsigned i;
+	struct list_elem *e;
+	struct buffer_head *victim = NULL;
 	/* find buffer_cache entry which is not used */
 	for(i=0; i<BUFFER_CACHE_ENTRY_NB; i++)
 	{
-		if(head_buffer[i].is_used == false){
+		if(head_buffer[i].is_used == false && head_buffer[i].busy == false){
 			return &head_buffer[i];
 		}
 	}
-	/* if buffer_cache is fulled. select the victim */
-	while(true)
+	/* if a1in is over its share, evict the oldest sector of a1in */
+	if(a1in_cnt > A1IN_SIZE || list_empty(&am))
+		victim = last_idle(&a1in);
+	if(victim == NULL)
 	{
-		if(clock_hand == BUFFER_CACHE_ENTRY_NB -1)
-			clock_hand = 0;
-		else
-			clock_hand++;
-		/* select the victim */
-		if(head_buffer[clock_hand].clock_bit == false)
+		/* evict least recently used sector of am. metadata up to
+		   its protected share is skipped while data can be evicted */
+		for(e = list_rbegin(&am); e != list_rend(&am); e = list_prev(e))
 		{
-			/* if dirty, flush to disk */
-			if(head_buffer[clock_hand].dirty == true)
+			struct buffer_head *b = list_entry(e, struct buffer_head, elem);
+			if(b->busy == false && (b->meta == false || meta_cnt > META_SHARE))
 			{
-				bc_flush_entry(&head_buffer[clock_hand]);
+				victim = b;
+				break;
 			}
-			/* update buffer head */
-			head_buffer[clock_hand].sector    = -1;
-			head_buffer[clock_hand].is_used   = false;
-			head_buffer[clock_hand].clock_bit = false;
-			/* return entry */
-			return &head_buffer[clock_hand];
 		}
-		else
+	}
+	if(victim == NULL)
+		victim = last_idle(&a1in);
+	if(victim == NULL)
+		victim = last_idle(&am);
+	return victim;
+}
+
+/* drop clean victim from the replacement queues */
+static void bc_evict(struct buffer_head *victim)
+{
+	if(victim->is_used == false)
+		return;
+	list_remove(&victim->elem);
+	if(victim->in_am == false)
+	{
+		a1in_cnt--;
+		a1out_add(victim->sector);
+	}
+	if(victim->meta == true)
+		meta_cnt--;
+	victim->sector  = -1;
+	victim->is_used = false;
+	victim->in_am   = false;
+	victim->meta    = false;
+}
+
+/* find buffer cache entry of sector, reading it from disk if not cached,
+   and update the replacement queues. must hold bc_lock, which is
+   released during disk I/O */
+static struct buffer_head *bc_get(block_sector_t sector, bool meta)
+{
+	struct buffer_head *sector_buffer;
+	struct buffer_head *flushed = NULL;
+
+	for(;;)
+	{
+		/* find the buffer cache entry of which block_sector_t is equal to sector_idx */
+		sector_buffer = bc_lookup(sector);
+		if(sector_buffer != NULL && sector_buffer->busy == true)
 		{
-			head_buffer[clock_hand].clock_bit = false;
+			/* wait until it is read in or written back */
+			cond_wait(&bc_io_done, &bc_lock);
+			continue;
 		}
+		if(sector_buffer != NULL)
+		{
+			bc_hit_cnt++;
+			if(meta == true && sector_buffer->meta == false)
+			{
+				sector_buffer->meta = true;
+				meta_cnt++;
+			}
+			/* referenced again. entry in a1in keeps its FIFO position */
+			if(sector_buffer->in_am == true)
+			{
+				list_remove(&sector_buffer->elem);
+				list_push_front(&am, &sector_buffer->elem);
+			}
+			return sector_buffer;
+		}
+		sector_buffer = bc_select_victim();
+		if(sector_buffer == NULL)
+		{
+			cond_wait(&bc_io_done, &bc_lock);
+			continue;
+		}
+		/* write back dirty victim, then look again, since another
+		   thread may have read sector in meanwhile */
+		if(sector_buffer->dirty == true)
+		{
+			bc_flush_entry(sector_buffer);
+			flushed = sector_buffer;
+			continue;
+		}
+		break;
+	}
+	/* if can't find the buffer cache entry */
+	bc_miss_cnt++;
+	if(sector_buffer->is_used == true)
+	{
+		if(sector_buffer == flushed)
+			bc_evict_dirty_cnt++;
+		else
+			bc_evict_clean_cnt++;
+	}
+	bc_evict(sector_buffer);
+	/* update buffer_head and read the data from disk. the busy entry
+	   makes others looking for sector wait for it */
+	sector_buffer->sector  = sector;
+	sector_buffer->is_used = true;
+	sector_buffer->meta    = meta;
+	sector_buffer->busy    = true;
+	if(meta == true)
+		meta_cnt++;
+	/* metadata and sector seen recently go to am, others to a1in */
+	if(a1out_remove(sector) == true || meta == true)
+	{
+		sector_buffer->in_am = true;
+		list_push_front(&am, &sector_buffer->elem);
 	}
+	else
+	{
+		sector_buffer->in_am = false;
+		list_push_front(&a1in, &sector_buffer->elem);
+		a1in_cnt++;
+	}
+	lock_release(&bc_lock);
+	block_read(fs_device, sector, sector_buffer->data);
+	lock_acquire(&bc_lock);
+	sector_buffer->busy = false;
+	cond_broadcast(&bc_io_done, &bc_lock);
+	return sector_buffer;
 }
 
 void bc_term(void)
@@ -419,44 +634,69 @@ void bc_term(void)
 	/* free the buffer cache */	
 	free(p_buffer_cache);
 }
-bool bc_read(block_sector_t sector_idx, void *buffer, off_t bytes_read, int chunck_size, int sector_ofs)
+/* read chunck_size bytes at sector_ofs of sector. meta is true if
+   sector holds file system metadata, which the cache protects */
+bool bc_read(block_sector_t sector_idx, void *buffer, off_t bytes_read, int chunck_size, int sector_ofs, bool meta)
 {
-	/* find the buffer cache entry of which block_sector_t is equal to sector_idx */
-	struct buffer_head *sector_buffer = bc_lookup(sector_idx);
-	/* if can't find the buffer cache entry */
-	if(sector_buffer == NULL)
-	{
-		sector_buffer = bc_select_victim();
-		/* update buffer_head and read the data from disk */
-		sector_buffer->sector    = sector_idx;
-		sector_buffer->is_used   = true;
-		block_read(fs_device, sector_idx, sector_buffer->data);
-	}
-	/* updata the clock bit */
-	sector_buffer->clock_bit = true;
+	struct buffer_head *sector_buffer;
+
+	lock_acquire(&bc_lock);
+	sector_buffer = bc_get(sector_idx, meta);
 	/* read data from buffer cache */
 	memcpy(buffer + bytes_read, sector_buffer->data + sector_ofs, chunck_size);
+	lock_release(&bc_lock);
 	return true;
 }
-bool bc_write(block_sector_t sector_idx, void *buffer, off_t bytes_written, int chunck_size, int sector_ofs)
+bool bc_write(block_sector_t sector_idx, void *buffer, off_t bytes_written, int chunck_size, int sector_ofs, bool meta)
 {
-	/* find the buffer cache entry of which block_sector_t is equal to sector_idx */
-	struct buffer_head *sector_buffer = bc_lookup(sector_idx);
-	/* if can't find the buffer cache entry */
-	if(sector_buffer == NULL)
-	{
-		sector_buffer = bc_select_victim();
-		/* update buffer_head and read the data from disk */
-		sector_buffer->sector  = sector_idx;
-		sector_buffer->is_used = true;
-		block_read(fs_device, sector_idx, sector_buffer->data);
-	}
+	struct buffer_head *sector_buffer;
+
+	lock_acquire(&bc_lock);
+	sector_buffer = bc_get(sector_idx, meta);
 	/* write the data to buffer_cache */
 	memcpy(sector_buffer->data + sector_ofs, buffer + bytes_written, chunck_size);
-	/* update the */
-	lock_acquire(&sector_buffer->buffer_lock);
-	sector_buffer->clock_bit = true;
-	sector_buffer->dirty     = true;
-	lock_release(&sector_buffer->buffer_lock);
+	sector_buffer->dirty = true;
+	lock_release(&bc_lock);
 	return true;  
 }
+/* copy chunck_size bytes at src_ofs of src sector to dst_ofs of dst
+   sector, from one buffer cache entry straight into the other */
+bool bc_copy(block_sector_t dst, int dst_ofs, block_sector_t src, int src_ofs, int chunck_size, bool meta)
+{
+	struct buffer_head *src_buffer;
+	struct buffer_head *dst_buffer;
+
+	lock_acquire(&bc_lock);
+	src_buffer = bc_get(src, false);
+	if(src == dst)
+		dst_buffer = src_buffer;
+	else
+	{
+		/* mark src busy so getting dst can't evict it */
+		src_buffer->busy = true;
+		dst_buffer = bc_get(dst, meta);
+		src_buffer->busy = false;
+		cond_broadcast(&bc_io_done, &bc_lock);
+	}
+	memmove(dst_buffer->data + dst_ofs, src_buffer->data + src_ofs, chunck_size);
+	dst_buffer->dirty = true;
+	lock_release(&bc_lock);
+	return true;
+}
+/* fill buffer cache statistics of st */
+void bc_get_stats(struct fsstat *st)
+{
+	lock_acquire(&bc_lock);
+	st->cache_hits  = bc_hit_cnt;
+	st->cache_misses = bc_miss_cnt;
+	st->evict_clean = bc_evict_clean_cnt;
+	st->evict_dirty = bc_evict_dirty_cnt;
+	st->write_backs = bc_write_back_cnt;
+	lock_release(&bc_lock);
+}
+/* print buffer cache statistics */
+void bc_print_stats(void)
+{
+	printf("Buffer cache: %llu hits, %llu misses, %llu clean evictions, %llu dirty evictions, %llu write-backs\n",
+			bc_hit_cnt, bc_miss_cnt, bc_evict_clean_cnt, bc_evict_dirty_cnt, bc_write_back_cnt);
+}
@@ -4,23 +4,35 @@
 #include "filesys/off_t.h"
 #include "devices/block.h"
 #include "threads/synch.h"
+#include "lib/kernel/list.h"
 #include "filesys/inode.h"
+#include <fsstat.h>
 
 
 #define BUFFER_CACHE_ENTRY_NB 64
 #define SECTOR_SIZE 512
 #define INDIRECT_BLOCK_ENTRIES 128
 #define DIRECT_BLOCK_ENTRIES 123
+/* sectors reserved beyond a growing file's current need */
+#define PREALLOC_SECTORS 16
+
+/* 2Q replacement: max entries in a1in, sectors remembered in a1out */
+#define A1IN_SIZE (BUFFER_CACHE_ENTRY_NB / 4)
+#define A1OUT_SIZE (BUFFER_CACHE_ENTRY_NB / 2)
+/* metadata entries up to this many are not evicted while data can be */
+#define META_SHARE (BUFFER_CACHE_ENTRY_NB / 2)
 
 /* structure for buffer_cache */
 struct buffer_head
 {
 	bool dirty;
 	bool is_used; 
-	bool clock_bit;
+	bool in_am;                /* in am queue, else in a1in */
+	bool meta;                 /* holds inode, index, directory or free map */
+	bool busy;                 /* being read or written back, outside bc_lock */
 	block_sector_t sector;
 	void* data;
-	struct lock buffer_lock;
+	struct list_elem elem;     /* element in a1in or am */
 };
 /* */
 enum direct_t {
@@ -45,13 +57,18 @@ struct inode_indirect_block
 void free_inode_sectors(struct inode_disk *inode_disk);
 block_sector_t byte_to_sector(const struct inode_disk *inode_disk, off_t pos);
 bool get_disk_inode(const struct inode *inode, struct inode_disk *inode_disk);
-bool inode_update_file_length(struct inode_disk *disk, off_t start_pos, off_t end_pos);
+bool inode_allocate_sector(struct inode_disk *inode_disk, off_t pos, size_t need, struct prealloc_window *window, block_sector_t *sectorp);
+void prealloc_release(struct prealloc_window *window);
+bool inode_uninline(struct inode_disk *inode_disk, struct prealloc_window *window);
 void bc_init (void);
 void bc_flush_entry (struct buffer_head *p_flush_entry);
 void bc_flush_all_entries(void);
 struct buffer_head* bc_lookup(block_sector_t sector);
 struct buffer_head* bc_select_victim(void);
 void bc_term(void);
-bool bc_read(block_sector_t sector_idx, void *buffer, off_t bytes_read, int chunck_size, int sector_ofs);
-bool bc_write(block_sector_t sector_idx, void *buffer, off_t bytes_written, int chunck_size, int sector_ofs);
+bool bc_read(block_sector_t sector_idx, void *buffer, off_t bytes_read, int chunck_size, int sector_ofs, bool meta);
+bool bc_write(block_sector_t sector_idx, void *buffer, off_t bytes_written, int chunck_size, int sector_ofs, bool meta);
+bool bc_copy(block_sector_t dst, int dst_ofs, block_sector_t src, int src_ofs, int chunck_size, bool meta);
+void bc_get_stats(struct fsstat *st);
+void bc_print_stats(void);
 #endif
@@ -2,9 +2,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <hash.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,6 +23,60 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* In-memory index of a directory, built from the on-disk entries
+   when the directory is first searched and kept up to date by
+   dir_add() and dir_remove().  The on-disk format is unchanged. */
+struct dir_index
+  {
+    struct hash names;                  /* Entries in use, by name. */
+    struct list free_slots;             /* Offsets of free entries. */
+    off_t end;                          /* Offset just past last entry. */
+    struct lock lock;                   /* Protects the index. */
+  };
+
+/* A name in a directory index. */
+struct index_entry
+  {
+    struct hash_elem elem;              /* Element in dir_index names. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t inode_sector;        /* Sector number of header. */
+    off_t ofs;                          /* Offset of entry in directory. */
+  };
+
+/* A free entry in a directory index. */
+struct free_slot
+  {
+    struct list_elem elem;              /* Element in dir_index free_slots. */
+    off_t ofs;                          /* Offset of entry in directory. */
+  };
+
+/* Number of entries read at once when building an index. */
+#define INDEX_READ_CNT 32
+
+/* A cached result of looking up NAME in the directory whose
+   inode is in sector PARENT.  Negative entries remember that
+   NAME does not exist. */
+struct dentry
+  {
+    struct hash_elem elem;              /* Element in dcache. */
+    struct list_elem lru_elem;          /* Element in dcache_lru. */
+    block_sector_t parent;              /* Sector of parent directory. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t inode_sector;        /* Sector of file, if positive. */
+    bool negative;                      /* True if NAME does not exist. */
+  };
+
+/* Maximum number of cached directory entries. */
+#define DCACHE_SIZE 256
+
+static struct hash dcache;              /* Cached entries. */
+static struct list dcache_lru;          /* Most recently used first. */
+static struct lock dcache_lock;         /* Protects dcache. */
+static size_t dcache_cnt;               /* Number of cached entries. */
+static unsigned dcache_gen;             /* Bumped on every invalidation. */
+
+static struct dir_index *get_index (const struct dir *);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -83,21 +139,321 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+static unsigned
+index_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct index_entry *ie = hash_entry (e, struct index_entry, elem);
+  return hash_string (ie->name);
+}
+
+static bool
+index_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  struct index_entry *ia = hash_entry (a, struct index_entry, elem);
+  struct index_entry *ib = hash_entry (b, struct index_entry, elem);
+  return strcmp (ia->name, ib->name) < 0;
+}
+
+static void
+index_entry_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct index_entry, elem));
+}
+
+/* Adds NAME at offset OFS to INDEX.  Returns false if out of memory. */
+static bool
+index_insert (struct dir_index *index, const char *name,
+              block_sector_t inode_sector, off_t ofs)
+{
+  struct index_entry *ie = malloc (sizeof *ie);
+  if (ie == NULL)
+    return false;
+  strlcpy (ie->name, name, sizeof ie->name);
+  ie->inode_sector = inode_sector;
+  ie->ofs = ofs;
+  /* A duplicate name on disk keeps the entry indexed first. */
+  if (hash_insert (&index->names, &ie->elem) != NULL)
+    free (ie);
+  return true;
+}
+
+/* Records free entry at offset OFS in INDEX.
+   Returns false if out of memory. */
+static bool
+index_add_free (struct dir_index *index, off_t ofs)
+{
+  struct free_slot *slot = malloc (sizeof *slot);
+  if (slot == NULL)
+    return false;
+  slot->ofs = ofs;
+  list_push_back (&index->free_slots, &slot->elem);
+  return true;
+}
+
+/* Removes NAME from INDEX and records its entry at OFS as free. */
+static void
+index_forget (struct dir_index *index, const char *name, off_t ofs)
+{
+  struct index_entry key;
+  struct hash_elem *found;
+
+  strlcpy (key.name, name, sizeof key.name);
+  lock_acquire (&index->lock);
+  found = hash_delete (&index->names, &key.elem);
+  if (found != NULL)
+    free (hash_entry (found, struct index_entry, elem));
+  index_add_free (index, ofs);
+  lock_release (&index->lock);
+}
+
+/* Frees INDEX. */
+static void
+index_free (struct dir_index *index)
+{
+  hash_destroy (&index->names, index_entry_free);
+  while (!list_empty (&index->free_slots))
+    free (list_entry (list_pop_front (&index->free_slots),
+                      struct free_slot, elem));
+  free (index);
+}
+
+/* Reads every entry of directory INODE into a new index.
+   Returns a null pointer if memory allocation fails. */
+static struct dir_index *
+index_build (struct inode *inode)
+{
+  struct dir_index *index;
+  struct dir_entry *entries;
+  off_t ofs = 0;
+  bool success = true;
+
+  index = malloc (sizeof *index);
+  entries = malloc (INDEX_READ_CNT * sizeof *entries);
+  if (index == NULL || entries == NULL
+      || !hash_init (&index->names, index_hash, index_less, NULL))
+    {
+      free (index);
+      free (entries);
+      return NULL;
+    }
+  list_init (&index->free_slots);
+  lock_init (&index->lock);
+
+  /* Read many entries per call instead of one. */
+  while (success)
+    {
+      off_t bytes = inode_read_at (inode, entries,
+                                   INDEX_READ_CNT * sizeof *entries, ofs);
+      size_t i, cnt = bytes > 0 ? bytes / sizeof *entries : 0;
+
+      for (i = 0; i < cnt && success; i++, ofs += sizeof *entries)
+        if (entries[i].in_use)
+          success = index_insert (index, entries[i].name,
+                                  entries[i].inode_sector, ofs);
+        else
+          success = index_add_free (index, ofs);
+      if (cnt < INDEX_READ_CNT)
+        break;
+    }
+  index->end = ofs;
+  free (entries);
+  if (!success)
+    {
+      index_free (index);
+      return NULL;
+    }
+  return index;
+}
+
+/* Returns the index of DIR, building it on first use.
+   The index belongs to the inode, so every opener of the
+   directory shares it.  Returns a null pointer if memory
+   allocation fails. */
+static struct dir_index *
+get_index (const struct dir *dir)
+{
+  struct inode *inode = dir->inode;
+  struct dir_index *index;
+
+  lock_acquire (&inode->extend_lock);
+  if (inode->dir_index == NULL)
+    inode->dir_index = index_build (inode);
+  index = inode->dir_index;
+  lock_release (&inode->extend_lock);
+  return index;
+}
+
+/* Frees the index of directory INODE, if it has one.
+   Called when the last opener closes INODE. */
+void
+dir_index_destroy (struct inode *inode)
+{
+  if (inode->dir_index != NULL)
+    {
+      index_free (inode->dir_index);
+      inode->dir_index = NULL;
+    }
+}
+
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct dentry *d = hash_entry (e, struct dentry, elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a, const struct hash_elem *b,
+             void *aux UNUSED)
+{
+  struct dentry *da = hash_entry (a, struct dentry, elem);
+  struct dentry *db = hash_entry (b, struct dentry, elem);
+  if (da->parent != db->parent)
+    return da->parent < db->parent;
+  return strcmp (da->name, db->name) < 0;
+}
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  hash_init (&dcache, dentry_hash, dentry_less, NULL);
+  list_init (&dcache_lru);
+  lock_init (&dcache_lock);
+  dcache_cnt = 0;
+  dcache_gen = 0;
+}
+
+/* Returns the cached entry for NAME in PARENT, or a null pointer.
+   Must be called with dcache_lock held. */
+static struct dentry *
+dcache_find (block_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *found;
+
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  found = hash_find (&dcache, &key.elem);
+  return found != NULL ? hash_entry (found, struct dentry, elem) : NULL;
+}
+
+/* Drops cached entry D.  Must be called with dcache_lock held. */
+static void
+dcache_drop (struct dentry *d)
+{
+  hash_delete (&dcache, &d->elem);
+  list_remove (&d->lru_elem);
+  dcache_cnt--;
+  free (d);
+}
+
+/* Caches the result of looking up NAME in PARENT, unless the
+   cache was invalidated since generation GEN was read.
+   The least recently used entry is evicted if the cache is full. */
+static void
+dcache_insert (block_sector_t parent, const char *name,
+               block_sector_t inode_sector, bool negative, unsigned gen)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  if (gen != dcache_gen || dcache_find (parent, name) != NULL)
+    goto done;
+  if (dcache_cnt >= DCACHE_SIZE)
+    dcache_drop (list_entry (list_back (&dcache_lru), struct dentry, lru_elem));
+  d = malloc (sizeof *d);
+  if (d == NULL)
+    goto done;
+  d->parent = parent;
+  strlcpy (d->name, name, sizeof d->name);
+  d->inode_sector = inode_sector;
+  d->negative = negative;
+  hash_insert (&dcache, &d->elem);
+  list_push_front (&dcache_lru, &d->lru_elem);
+  dcache_cnt++;
+ done:
+  lock_release (&dcache_lock);
+}
+
+/* Removes the cached entry for NAME in PARENT, if any. */
+static void
+dcache_invalidate (block_sector_t parent, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  d = dcache_find (parent, name);
+  if (d != NULL)
+    dcache_drop (d);
+  lock_release (&dcache_lock);
+}
+
+/* Removes every cached entry of directory PARENT, which is being
+   removed, so nothing stale remains if its sector is reused. */
+static void
+dcache_invalidate_dir (block_sector_t parent)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->parent == parent)
+        dcache_drop (d);
+    }
+  lock_release (&dcache_lock);
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Uses the directory index, falling back to a linear scan of
+   the directory if the index cannot be built. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
   size_t ofs;
+  struct dir_index *index;
+  struct index_entry key;
+  struct hash_elem *found;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  index = get_index (dir);
+  if (index != NULL)
+    {
+      if (strlen (name) > NAME_MAX)
+        return false;
+      strlcpy (key.name, name, sizeof key.name);
+      lock_acquire (&index->lock);
+      found = hash_find (&index->names, &key.elem);
+      if (found != NULL)
+        {
+          struct index_entry *ie = hash_entry (found, struct index_entry, elem);
+          if (ep != NULL)
+            {
+              ep->inode_sector = ie->inode_sector;
+              strlcpy (ep->name, ie->name, sizeof ep->name);
+              ep->in_use = true;
+            }
+          if (ofsp != NULL)
+            *ofsp = ie->ofs;
+        }
+      lock_release (&index->lock);
+      return found != NULL;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e){ 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -121,11 +477,41 @@ dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
   struct dir_entry e;
+  block_sector_t parent;
+  struct dentry *d;
+  unsigned gen;
+  bool found;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
+  if (strlen (name) > NAME_MAX)
+    {
+      *inode = NULL;
+      return false;
+    }
+
+  /* Look in the directory entry cache first. */
+  parent = inode_get_inumber (dir->inode);
+  lock_acquire (&dcache_lock);
+  d = dcache_find (parent, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&dcache_lru, &d->lru_elem);
+      e.inode_sector = d->inode_sector;
+      found = !d->negative;
+      lock_release (&dcache_lock);
+    }
+  else
+    {
+      gen = dcache_gen;
+      lock_release (&dcache_lock);
+      found = lookup (dir, name, &e, NULL);
+      dcache_insert (parent, name, found ? e.inode_sector : 0, !found, gen);
+    }
+
+  if (found)
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
@@ -145,6 +531,8 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   struct dir_entry e;
   off_t ofs;
   bool success = false;
+  struct dir_index *index;
+  struct free_slot *slot;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -159,21 +547,50 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+     current end-of-file. */
+  index = get_index (dir);
+  if (index != NULL)
+    {
+      lock_acquire (&index->lock);
+      if (!list_empty (&index->free_slots))
+        {
+          slot = list_entry (list_pop_front (&index->free_slots),
+                             struct free_slot, elem);
+          ofs = slot->ofs;
+          free (slot);
+        }
+      else
+        {
+          ofs = index->end;
+          index->end += sizeof e;
+        }
+      if (!index_insert (index, name, inode_sector, ofs))
+        {
+          index_add_free (index, ofs);
+          lock_release (&index->lock);
+          goto done;
+        }
+      lock_release (&index->lock);
+    }
+  else
+    {
+      /* inode_read_at() will only return a short read at end of file.
+         Otherwise, we'd need to verify that we didn't get a short
+         read due to something intermittent such as low memory. */
+      for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+           ofs += sizeof e) 
+        if (!e.in_use)
+          break;
+    }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (!success && index != NULL)
+    index_forget (index, name, ofs);
 
  done:
   return success;
@@ -189,6 +606,7 @@ dir_remove (struct dir *dir, const char *name)
   struct inode *inode = NULL;
   bool success = false;
   off_t ofs;
+  struct dir_index *index;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -208,6 +626,12 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  index = get_index (dir);
+  if (index != NULL)
+    index_forget (index, name, ofs);
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (inode_is_dir (inode))
+    dcache_invalidate_dir (e.inode_sector);
 
   /* Remove inode. */
   inode_remove (inode);
@@ -114,6 +114,31 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes from SRC, starting at its current position,
+   into DST at its current position, without passing the data
+   through a caller's buffer.  Returns the number of bytes
+   actually copied, which may be less than SIZE if end of SRC is
+   reached.  Advances both positions by the number of bytes
+   copied.  Returns -1 without copying if SRC and DST are the same
+   inode and the ranges overlap. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied;
+
+  if (size <= 0)
+    return 0;
+  /* Compares differences, since POS + SIZE may overflow. */
+  if (src->inode == dst->inode
+      && src->pos - dst->pos < size && dst->pos - src->pos < size)
+    return -1;
+  bytes_copied = inode_copy_range (dst->inode, dst->pos,
+                                   src->inode, src->pos, size);
+  src->pos += bytes_copied;
+  dst->pos += bytes_copied;
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
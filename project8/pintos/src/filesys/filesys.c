@@ -24,6 +24,7 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  dcache_init ();
   bc_init ();
   free_map_init ();
 
@@ -39,8 +40,11 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
-  bc_term ();	
+  /* give back preallocated sectors before the last free map flush */
+  inode_release_preallocs ();
+  /* free map is written through buffer cache, close it first */
   free_map_close ();
+  bc_term ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
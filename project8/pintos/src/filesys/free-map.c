@@ -8,6 +8,34 @@
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Bits of the free map stored in one sector of the free map file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+/* Range of free map file sectors changed since the last
+   free_map_flush(), as [dirty_lo, dirty_hi).  Empty if equal. */
+static size_t dirty_lo, dirty_hi;
+
+/* Records that bits SECTOR...SECTOR+CNT-1 changed. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t lo = sector / BITS_PER_SECTOR;
+  size_t hi = (sector + cnt - 1) / BITS_PER_SECTOR + 1;
+
+  if (dirty_lo == dirty_hi)
+    {
+      dirty_lo = lo;
+      dirty_hi = hi;
+    }
+  else
+    {
+      if (lo < dirty_lo)
+        dirty_lo = lo;
+      if (hi > dirty_hi)
+        dirty_hi = hi;
+    }
+}
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -22,31 +50,72 @@ free_map_init (void)
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available.  The change reaches the free map file
+   at the next free_map_flush(). */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      mark_dirty (sector, cnt);
+      *sectorp = sector;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates a run of up to MAX_CNT consecutive sectors, starting
+   at the first free sector at or after GOAL (or anywhere if there
+   is none after GOAL), and stores the first into *SECTORP.
+   Returns the number of sectors allocated, 0 on failure. */
+size_t
+free_map_allocate_run (block_sector_t goal, size_t max_cnt,
+                       block_sector_t *sectorp)
+{
+  size_t start, cnt;
+  size_t size = bitmap_size (free_map);
+
+  ASSERT (max_cnt > 0);
+  if (goal >= size)
+    goal = 0;
+  start = bitmap_scan (free_map, goal, 1, false);
+  if (start == BITMAP_ERROR && goal != 0)
+    start = bitmap_scan (free_map, 0, 1, false);
+  if (start == BITMAP_ERROR)
+    return 0;
+
+  /* Extend the run while the following sectors are free. */
+  for (cnt = 1; cnt < max_cnt && start + cnt < size; cnt++)
+    if (bitmap_test (free_map, start + cnt))
+      break;
+
+  bitmap_set_multiple (free_map, start, cnt, true);
+  mark_dirty (start, cnt);
+  *sectorp = start;
+  return cnt;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+}
+
+/* Writes the sectors of the free map changed since the last
+   flush to the free map file. */
+void
+free_map_flush (void)
+{
+  if (free_map_file == NULL || dirty_lo == dirty_hi)
+    return;
+  if (!bitmap_write_range (free_map, free_map_file,
+                           dirty_lo * BLOCK_SECTOR_SIZE,
+                           (dirty_hi - dirty_lo) * BLOCK_SECTOR_SIZE))
+    PANIC ("can't write free map");
+  dirty_lo = dirty_hi = 0;
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -64,7 +133,9 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -1,5 +1,7 @@
 #include "filesys/inode.h"
 #include <list.h>
+#include <hash.h>
+#include <stdio.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
@@ -7,6 +9,7 @@
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
 #include "filesys/buffer_cache.h"
+#include "filesys/directory.h"
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
@@ -49,15 +52,91 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 */
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Hash table of open inodes by sector, so that opening a single
+   inode twice returns the same `struct inode'. */
+static struct hash open_inodes;
+/* Protects open_inodes and open_cnt of every inode. */
+static struct lock open_inodes_lock;
+/* Number of open inodes and the most ever open at once. */
+static size_t open_inode_cnt;
+static size_t open_inode_peak;
+/* Bytes read and written through all inodes. */
+static unsigned long long total_read_bytes;
+static unsigned long long total_write_bytes;
+
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  struct inode *inode_a = hash_entry (a, struct inode, elem);
+  struct inode *inode_b = hash_entry (b, struct inode, elem);
+  return inode_a->sector < inode_b->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
+  open_inode_cnt = 0;
+  open_inode_peak = 0;
+}
+
+/* Prints open inode statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inodes: %zu open, %zu peak open, %llu bytes read, "
+          "%llu bytes written\n", open_inode_cnt, open_inode_peak,
+          total_read_bytes, total_write_bytes);
+}
+
+/* Fills inode statistics of ST, with bytes read and written
+   through INODE, or through all inodes if INODE is null. */
+void
+inode_get_stats (const struct inode *inode, struct fsstat *st)
+{
+  lock_acquire (&open_inodes_lock);
+  st->open_inodes = open_inode_cnt;
+  if (inode != NULL)
+    {
+      st->bytes_read = inode->read_bytes;
+      st->bytes_written = inode->write_bytes;
+    }
+  else
+    {
+      st->bytes_read = total_read_bytes;
+      st->bytes_written = total_write_bytes;
+    }
+  lock_release (&open_inodes_lock);
+}
+
+/* Gives back the sectors reserved but not used by every open
+   inode, so that the final free map flush does not record them
+   as used. */
+void
+inode_release_preallocs (void)
+{
+  struct hash_iterator i;
+
+  lock_acquire (&open_inodes_lock);
+  hash_first (&i, &open_inodes);
+  while (hash_next (&i))
+    {
+      struct inode *inode = hash_entry (hash_cur (&i), struct inode, elem);
+      lock_acquire (&inode->extend_lock);
+      prealloc_release (&inode->prealloc);
+      lock_release (&inode->extend_lock);
+    }
+  lock_release (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -83,14 +162,10 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
 	  disk_inode->is_dir = is_dir;
-	  if(length > 0)
-	  {
-		  if(inode_update_file_length(disk_inode, 0, length) == false){
-			  free(disk_inode);
-			  return false;
-		  }
-	  }
-	  bc_write(sector, disk_inode, 0, SECTOR_SIZE, 0);
+	  /* no block is allocated. small file starts inline, larger
+	     file is a hole of LENGTH bytes until data is written */
+	  disk_inode->is_inline = length <= INLINE_DATA_SIZE;
+	  bc_write(sector, disk_inode, 0, SECTOR_SIZE, 0, true);
       free (disk_inode);
 	  success = true;
     }
@@ -103,33 +178,46 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
+  lock_acquire (&open_inodes_lock);
+
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   lock_init(&inode->extend_lock);
+  inode->dir_index = NULL;
+  inode->prealloc.start = 0;
+  inode->prealloc.cnt = 0;
+  inode->read_bytes = 0;
+  inode->write_bytes = 0;
+  hash_insert (&open_inodes, &inode->elem);
+  if (++open_inode_cnt > open_inode_peak)
+    open_inode_peak = open_inode_cnt;
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -138,7 +226,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -155,15 +247,28 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.
+     Once out of the table, nobody else can find INODE. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      hash_delete (&open_inodes, &inode->elem);
+      open_inode_cnt--;
+    }
+  lock_release (&open_inodes_lock);
+
+  if (last)
+    {
+      dir_index_destroy (inode);
+      /* Trim sectors reserved but not used. */
+      prealloc_release (&inode->prealloc);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
@@ -187,6 +292,14 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if data of INODE is file system metadata, which is
+   directory contents and the free map. */
+static bool
+inode_is_meta (const struct inode *inode, const struct inode_disk *disk_inode)
+{
+  return disk_inode->is_dir == IS_DIR || inode->sector == FREE_MAP_SECTOR;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -195,12 +308,26 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  bool meta;
 
   struct inode_disk *inode_disk;
   inode_disk = (struct inode_disk *)malloc(SECTOR_SIZE);
   if(inode_disk == NULL)
 	  return -1;
   get_disk_inode(inode, inode_disk);
+  meta = inode_is_meta(inode, inode_disk);
+  /* small file is read from inode sector */
+  if (inode_disk->is_inline)
+    {
+      if (offset < inode_disk->length)
+        {
+          bytes_read = inode_disk->length - offset;
+          if (size < bytes_read)
+            bytes_read = size;
+          memcpy (buffer, inode_disk->inline_data + offset, bytes_read);
+        }
+      size = 0;
+    }
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -217,7 +344,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-	  bc_read(sector_idx, buffer, bytes_read, chunk_size, sector_ofs);
+	  /* hole reads as zeros */
+	  if(sector_idx == 0)
+		  memset(buffer + bytes_read, 0, chunk_size);
+	  else
+		  bc_read(sector_idx, buffer, bytes_read, chunk_size, sector_ofs, meta);
 
       /* Advance. */
       size -= chunk_size;
@@ -225,6 +356,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
   free(inode_disk);
+  inode->read_bytes += bytes_read;
+  total_read_bytes += bytes_read;
   return bytes_read;
 }
 
@@ -240,6 +373,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   struct inode_disk *disk_inode;
+  off_t old_length;
+  bool meta;
 
   if (inode->deny_write_cnt)
     return 0;
@@ -248,17 +383,32 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if(disk_inode == NULL)
 	  return 0;
 
-  get_disk_inode(inode, disk_inode);
-
+  /* extend_lock serializes writers, which allocate blocks and
+     update length in their copy of the disk inode */
   lock_acquire(&inode->extend_lock);
-  int old_length = disk_inode->length;
-  int write_end  = offset + size - 1;
-  if(write_end > old_length - 1)
+  get_disk_inode(inode, disk_inode);
+  old_length = disk_inode->length;
+  meta = inode_is_meta(inode, disk_inode);
+  if(disk_inode->is_inline)
   {
-	  inode_update_file_length(disk_inode, old_length, write_end);
-	  disk_inode->length += write_end - old_length + 1;
+	  /* data still fits in inode sector */
+	  if(offset + size <= INLINE_DATA_SIZE)
+	  {
+		  memcpy(disk_inode->inline_data + offset, buffer, size);
+		  bytes_written = size;
+		  offset += size;
+		  size = 0;
+	  }
+	  /* file grows too big, move data to a disk block */
+	  else if(inode_uninline(disk_inode, &inode->prealloc) == false)
+	  {
+		  lock_release(&inode->extend_lock);
+		  free(disk_inode);
+		  return 0;
+	  }
   }
-  lock_release(&inode->extend_lock);
+  if(offset + size > disk_inode->length)
+	  disk_inode->length = offset + size;
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
@@ -274,18 +424,157 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-	  bc_write(sector_idx, (void *)buffer, bytes_written, chunk_size, sector_ofs);	
+	  /* allocate block for hole only when data is written to it */
+	  if(sector_idx == 0
+		 && inode_allocate_sector(disk_inode, offset - sector_ofs,
+			 DIV_ROUND_UP(size + sector_ofs, BLOCK_SECTOR_SIZE),
+			 &inode->prealloc, &sector_idx) == false)
+		  break;
+	  bc_write(sector_idx, (void *)buffer, bytes_written, chunk_size, sector_ofs, meta);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+  /* file ends where writing stopped if disk is full */
+  if(size > 0 && offset < disk_inode->length && disk_inode->length > old_length)
+	  disk_inode->length = offset > old_length ? offset : old_length;
   /* update disk_inode to disk */
-  bc_write(inode->sector, (void *)disk_inode, 0, SECTOR_SIZE, 0);
+  bc_write(inode->sector, (void *)disk_inode, 0, SECTOR_SIZE, 0, true);
+  lock_release(&inode->extend_lock);
+  free(disk_inode);
+  inode->write_bytes += bytes_written;
+  total_write_bytes += bytes_written;
   return bytes_written;
 }
 
+/* Adds BYTES read from INODE to the statistics. */
+static void
+inode_count_read (struct inode *inode, off_t bytes)
+{
+  inode->read_bytes += bytes;
+  total_read_bytes += bytes;
+}
+
+/* Copies SIZE bytes of SRC starting at SRC_OFS into DST starting
+   at DST_OFS, moving the data from one buffer cache entry to the
+   other instead of through a buffer.  A hole of SRC copied where
+   DST has no block stays a hole.  Returns the number of bytes
+   actually copied, which may be less than SIZE if end of SRC is
+   reached or the disk is full.  The ranges must not overlap if
+   SRC and DST are the same inode. */
+off_t
+inode_copy_range (struct inode *dst, off_t dst_ofs, struct inode *src,
+                  off_t src_ofs, off_t size)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct inode_disk *dst_disk, *src_disk;
+  off_t bytes_copied = 0;
+  off_t old_length;
+  bool meta;
+
+  if (dst->deny_write_cnt || size <= 0 || dst_ofs < 0 || src_ofs < 0)
+    return 0;
+  /* Keep the end of the destination range within off_t. */
+  if (size > INT32_MAX - dst_ofs)
+    size = INT32_MAX - dst_ofs;
+
+  dst_disk = (struct inode_disk *)malloc(SECTOR_SIZE);
+  src_disk = (struct inode_disk *)malloc(SECTOR_SIZE);
+  if(dst_disk == NULL || src_disk == NULL)
+  {
+	  free(dst_disk);
+	  free(src_disk);
+	  return 0;
+  }
+  lock_acquire(&dst->extend_lock);
+  get_disk_inode(dst, dst_disk);
+  get_disk_inode(src, src_disk);
+  old_length = dst_disk->length;
+  meta = inode_is_meta(dst, dst_disk);
+  if (src_ofs >= src_disk->length)
+    size = 0;
+  else if (size > src_disk->length - src_ofs)
+    size = src_disk->length - src_ofs;
+
+  if (size == 0)
+    ;
+  /* small source is already in memory, in its inode sector */
+  else if (src_disk->is_inline)
+    {
+      lock_release(&dst->extend_lock);
+      bytes_copied = inode_write_at (dst, src_disk->inline_data + src_ofs,
+                                     size, dst_ofs);
+      free(dst_disk);
+      free(src_disk);
+      inode_count_read (src, bytes_copied);
+      return bytes_copied;
+    }
+  /* small destination stays in its inode sector */
+  else if (dst_disk->is_inline && dst_ofs + size <= INLINE_DATA_SIZE)
+    {
+      bytes_copied = inode_read_at (src, dst_disk->inline_data + dst_ofs,
+                                    size, src_ofs);
+      if (dst_ofs + bytes_copied > dst_disk->length)
+        dst_disk->length = dst_ofs + bytes_copied;
+      size = 0;
+    }
+  else if (dst_disk->is_inline
+           && inode_uninline(dst_disk, &dst->prealloc) == false)
+    size = 0;
+
+  if(size > 0 && dst_ofs + size > dst_disk->length)
+	  dst_disk->length = dst_ofs + size;
+  while (size > 0)
+    {
+      /* Sectors and offsets within them on both sides. */
+      block_sector_t src_sector = byte_to_sector (src_disk, src_ofs);
+      block_sector_t dst_sector = byte_to_sector (dst_disk, dst_ofs);
+      int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+
+      /* Bytes to copy without crossing a sector on either side. */
+      int chunk_size = BLOCK_SECTOR_SIZE - (src_sector_ofs > dst_sector_ofs
+                                            ? src_sector_ofs : dst_sector_ofs);
+      if (size < chunk_size)
+        chunk_size = size;
+
+	  /* hole over hole stays a hole, otherwise dst needs a block */
+	  if(src_sector != 0 || dst_sector != 0)
+	  {
+		  if(dst_sector == 0
+			 && inode_allocate_sector(dst_disk, dst_ofs - dst_sector_ofs,
+				 DIV_ROUND_UP(size + dst_sector_ofs, BLOCK_SECTOR_SIZE),
+				 &dst->prealloc, &dst_sector) == false)
+			  break;
+		  if(src_sector == 0)
+			  bc_write(dst_sector, zeros, 0, chunk_size, dst_sector_ofs, meta);
+		  else
+			  bc_copy(dst_sector, dst_sector_ofs, src_sector, src_sector_ofs, chunk_size, meta);
+	  }
+
+      /* Advance. */
+      size -= chunk_size;
+      src_ofs += chunk_size;
+      dst_ofs += chunk_size;
+      bytes_copied += chunk_size;
+    }
+  /* inode_read_at counted the bytes read for inline destination */
+  if(!dst_disk->is_inline)
+	  inode_count_read(src, bytes_copied);
+  /* file ends where copying stopped if disk is full */
+  if(size > 0 && dst_ofs < dst_disk->length && dst_disk->length > old_length)
+	  dst_disk->length = dst_ofs > old_length ? dst_ofs : old_length;
+  bc_write(dst->sector, (void *)dst_disk, 0, SECTOR_SIZE, 0, true);
+  lock_release(&dst->extend_lock);
+  free(dst_disk);
+  free(src_disk);
+  dst->write_bytes += bytes_copied;
+  total_write_bytes += bytes_copied;
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -5,31 +5,55 @@
 #include "filesys/off_t.h"
 #include "devices/block.h"
 #include "threads/synch.h"
-#include "lib/kernel/list.h"
+#include "lib/kernel/hash.h"
+#include <fsstat.h>
 
 #define IS_DIR 1
 #define IS_FILE 0
+/* files up to this size keep their data in the inode sector */
+#define INLINE_DATA_SIZE 500
 
 struct bitmap;
+struct dir_index;
+/* sectors reserved for growing a file contiguously */
+struct prealloc_window
+{
+	block_sector_t start;          /* first reserved sector */
+	size_t cnt;                    /* number of reserved sectors */
+};
 /* IN MEMORY I-NODE */
 struct inode
 {
-	struct list_elem elem;
+	struct hash_elem elem;         /* element in open_inodes */
 	block_sector_t sector;
 	int open_cnt;
 	bool removed;
 	int deny_write_cnt;
 	struct lock extend_lock;
+	struct dir_index *dir_index;   /* name index, if inode is directory */
+	struct prealloc_window prealloc; /* protected by extend_lock */
+	unsigned long long read_bytes;   /* bytes read through inode */
+	unsigned long long write_bytes;  /* bytes written through inode */
 };
 /* ON DISK I NODE */
 struct inode_disk
 {
 	off_t length;
 	unsigned magic;
-	uint32_t is_dir;
-	block_sector_t direct_map_table[123];
-	block_sector_t indirect_block_sec;
-	block_sector_t double_indirect_block_sec;
+	uint16_t is_dir;
+	uint16_t is_inline;        /* data is stored in inline_data */
+	union
+	{
+		/* block map of file */
+		struct
+		{
+			block_sector_t direct_map_table[123];
+			block_sector_t indirect_block_sec;
+			block_sector_t double_indirect_block_sec;
+		};
+		/* data of small file, stored in inode sector */
+		uint8_t inline_data[INLINE_DATA_SIZE];
+	};
 };
 
 void inode_init (void);
@@ -41,8 +65,13 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_copy_range (struct inode *dst, off_t dst_ofs, struct inode *src,
+                        off_t src_ofs, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 bool inode_is_dir(const struct inode *inode);
+void inode_print_stats (void);
+void inode_get_stats (const struct inode *, struct fsstat *);
+void inode_release_preallocs (void);
 #endif /* filesys/inode.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_FSSTAT_H
+#define __LIB_FSSTAT_H
+
+/* File system statistics, filled in by the fsstat system call. */
+struct fsstat
+  {
+    /* Buffer cache. */
+    unsigned long long cache_hits;      /* Accesses found in cache. */
+    unsigned long long cache_misses;    /* Accesses read from disk. */
+    unsigned long long evict_clean;     /* Clean entries evicted. */
+    unsigned long long evict_dirty;     /* Dirty entries evicted. */
+    unsigned long long write_backs;     /* Dirty entries written to disk. */
+
+    /* Inodes.  Bytes are for the inode of the given file
+       descriptor, or for all inodes if it is not open. */
+    unsigned long long bytes_read;      /* Bytes read by inode_read_at(). */
+    unsigned long long bytes_written;   /* Bytes written by inode_write_at(). */
+    unsigned open_inodes;               /* Inodes open now. */
+  };
+
+#endif /* lib/fsstat.h */
@@ -0,0 +1,14 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+/* One buffer of a readv() or writev() system call. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    unsigned iov_len;           /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one readv() or writev(). */
+#define IOV_MAX 16
+
+#endif /* lib/uio.h */
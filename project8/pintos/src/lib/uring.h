@@ -0,0 +1,56 @@
+#ifndef __LIB_URING_H
+#define __LIB_URING_H
+
+/* A ring shared by a process and the kernel for submitting many
+   system calls with a single trap.
+
+   The process fills submission entries at SQ_TAIL, advances
+   SQ_TAIL, and calls uring_enter().  The kernel carries out the
+   entries from SQ_HEAD onward in order, advancing SQ_HEAD, and
+   posts a completion for each at CQ_TAIL.  The process consumes
+   completions from CQ_HEAD.  Indexes run freely and are taken
+   modulo URING_ENTRIES. */
+
+/* Operations. */
+enum uring_op
+  {
+    URING_NOP,                  /* Does nothing, result 0. */
+    URING_OPEN,                 /* open (BUF). */
+    URING_CLOSE,                /* close (FD), result 0. */
+    URING_READ,                 /* read (FD, BUF, LEN). */
+    URING_WRITE,                /* write (FD, BUF, LEN). */
+    URING_PREAD,                /* pread (FD, BUF, LEN, OFFSET). */
+    URING_PWRITE,               /* pwrite (FD, BUF, LEN, OFFSET). */
+    URING_FILESIZE              /* filesize (FD). */
+  };
+
+/* A submission entry. */
+struct uring_sqe
+  {
+    int op;                     /* An enum uring_op. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer, or file name for open. */
+    unsigned len;               /* Buffer length. */
+    unsigned offset;            /* File offset for pread, pwrite. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* A completion entry. */
+struct uring_cqe
+  {
+    unsigned user_data;         /* From the submission entry. */
+    int result;                 /* What the system call returned. */
+  };
+
+/* Entries in each ring.  The whole ring fits in one page. */
+#define URING_ENTRIES 64
+
+struct uring
+  {
+    unsigned sq_head, sq_tail;  /* Submission ring indexes. */
+    unsigned cq_head, cq_tail;  /* Completion ring indexes. */
+    struct uring_sqe sq[URING_ENTRIES];
+    struct uring_cqe cq[URING_ENTRIES];
+  };
+
+#endif /* lib/uring.h */
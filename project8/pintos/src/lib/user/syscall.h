@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <fsstat.h>
+#include <uio.h>
+#include <uring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +48,14 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool fsstat (int fd, struct fsstat *);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+struct uring *uring_setup (void);
+int uring_enter (unsigned to_submit);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+
 #endif /* lib/user/syscall.h */
@@ -2,12 +2,21 @@
 use strict;
 use warnings;
 use tests::tests;
-check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run.
+s/: \d+ cycles/: N cycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
 (sm-random) begin
 (sm-random) create "bazzle"
 (sm-random) open "bazzle"
 (sm-random) write "bazzle" in random order
 (sm-random) read "bazzle" in random order
+(sm-random) pread in random order: N cycles
+(sm-random) seek and read in random order: N cycles
+(sm-random) readv in order: N cycles
 (sm-random) close "bazzle"
 (sm-random) end
 EOF
@@ -0,0 +1,136 @@
+/* Measures how well the buffer cache keeps file system metadata
+   while a file larger than the cache is read sequentially.  A
+   tree of small files is walked once before the scan and then
+   repeatedly during it.  With a scan-resistant cache the walks
+   during the scan find their inodes and directories in the cache
+   and cost about as much as the walk before it.  The test fails
+   unless the cache hit rate of the walks during the scan stays
+   at or above MIN_HIT_RATE. */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DIR_CNT 4               /* Directories in the tree. */
+#define FILE_CNT 6              /* Small files per directory. */
+#define STREAM_SIZE (128 * 1024) /* Size of streamed file. */
+#define CHUNK_SIZE 4096         /* Bytes read per streaming step. */
+#define WALK_EVERY 4            /* Streaming steps between walks. */
+#define MIN_HIT_RATE 90         /* Lowest passing hit rate, in percent. */
+
+static char buf[CHUNK_SIZE];
+
+/* Builds the name of small file FILE in directory DIR into NAME. */
+static void
+file_name (char name[32], int dir, int file)
+{
+  snprintf (name, 32, "/d%d/f%d", dir, file);
+}
+
+/* Cache hits and misses of the walks during the scan. */
+static unsigned long long walk_hits, walk_misses;
+
+/* Opens and reads every small file.  Returns the cycles taken. */
+static uint64_t
+walk (void)
+{
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
+  struct fsstat before, after;
+  char name[32];
+  char data[16];
+  int d, f, fd;
+
+  fsstat (-1, &before);
+  for (d = 0; d < DIR_CNT; d++)
+    for (f = 0; f < FILE_CNT; f++)
+      {
+        file_name (name, d, f);
+        fd = open (name);
+        if (fd < 2)
+          fail ("open \"%s\" failed", name);
+        if (read (fd, data, sizeof data) <= 0)
+          fail ("read \"%s\" failed", name);
+        close (fd);
+      }
+  cycles = rdtsc () - start;
+  fsstat (-1, &after);
+  walk_hits += after.cache_hits - before.cache_hits;
+  walk_misses += after.cache_misses - before.cache_misses;
+  return cycles;
+}
+
+void
+test_main (void)
+{
+  uint64_t before, during = 0;
+  char name[32];
+  int d, f, fd, walks = 0;
+  unsigned long long hit_rate;
+  size_t ofs;
+
+  /* Build the tree of small files and the file to stream. */
+  for (d = 0; d < DIR_CNT; d++)
+    {
+      snprintf (name, sizeof name, "/d%d", d);
+      if (!mkdir (name))
+        fail ("mkdir \"%s\" failed", name);
+      for (f = 0; f < FILE_CNT; f++)
+        {
+          file_name (name, d, f);
+          if (!create (name, 0) || (fd = open (name)) < 2)
+            fail ("create \"%s\" failed", name);
+          write (fd, name, strlen (name) + 1);
+          close (fd);
+        }
+    }
+  memset (buf, 'x', sizeof buf);
+  if (!create ("stream", 0) || (fd = open ("stream")) < 2)
+    fail ("create \"stream\" failed");
+  for (ofs = 0; ofs < STREAM_SIZE; ofs += CHUNK_SIZE)
+    if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("write \"stream\" failed");
+  close (fd);
+
+  /* Walk with the tree in the cache, then while streaming. */
+  walk ();
+  before = walk ();
+  walk_hits = walk_misses = 0;
+  fd = open ("stream");
+  if (fd < 2)
+    fail ("open \"stream\" failed");
+  for (ofs = 0; ofs < STREAM_SIZE; ofs += CHUNK_SIZE)
+    {
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read \"stream\" failed");
+      if ((ofs / CHUNK_SIZE) % WALK_EVERY == WALK_EVERY - 1)
+        {
+          during += walk ();
+          walks++;
+        }
+    }
+  close (fd);
+
+  msg ("walk before scan: %llu cycles", before);
+  msg ("walk during scan: %llu cycles", during / walks);
+  hit_rate = walk_hits * 100 / (walk_hits + walk_misses);
+  if (hit_rate < MIN_HIT_RATE)
+    fail ("cache hit rate of walks during scan is %llu%%, "
+          "less than %d%%", hit_rate, MIN_HIT_RATE);
+  msg ("cache hit rate of walks during scan at least %d%%", MIN_HIT_RATE);
+
+  /* Leave the file system empty. */
+  for (d = 0; d < DIR_CNT; d++)
+    {
+      for (f = 0; f < FILE_CNT; f++)
+        {
+          file_name (name, d, f);
+          remove (name);
+        }
+      snprintf (name, sizeof name, "/d%d", d);
+      remove (name);
+    }
+  remove ("stream");
+}
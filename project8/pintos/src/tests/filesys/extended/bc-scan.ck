@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run.
+s/: \d+ cycles/: N cycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(bc-scan) begin
+(bc-scan) walk before scan: N cycles
+(bc-scan) walk during scan: N cycles
+(bc-scan) cache hit rate of walks during scan at least 90%
+(bc-scan) end
+EOF
+pass;
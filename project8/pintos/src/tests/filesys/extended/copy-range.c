@@ -0,0 +1,112 @@
+/* Copies a file larger than the buffer cache once through a user
+   buffer and once with copy_file_range(), which moves the data
+   inside the kernel, and compares the time taken.  A copy between
+   offsets that are not sector aligned is checked as well. */
+
+#include <random.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (64 * 1024)   /* Size of copied file. */
+#define CHUNK_SIZE 4096         /* Bytes per read or copy. */
+#define SKEW 100                /* Offset of the unaligned copy. */
+
+static char buf[CHUNK_SIZE];
+static char data[FILE_SIZE];
+
+/* Checks that SIZE bytes of file NAME at OFS match DATA at DATA_OFS. */
+static void
+check_copy (const char *name, size_t ofs, size_t data_ofs, size_t size)
+{
+  int fd = open (name);
+  size_t i;
+
+  if (fd < 2)
+    fail ("open \"%s\" failed", name);
+  for (i = 0; i < size; i += CHUNK_SIZE)
+    {
+      size_t n = size - i < CHUNK_SIZE ? size - i : CHUNK_SIZE;
+      if (pread (fd, buf, n, ofs + i) != (int) n)
+        fail ("read \"%s\" failed", name);
+      if (memcmp (buf, data + data_ofs + i, n))
+        fail ("\"%s\" differs from original at offset %zu", name, ofs + i);
+    }
+  close (fd);
+}
+
+/* Creates NAME and returns a descriptor for it. */
+static int
+create_open (const char *name)
+{
+  int fd;
+
+  if (!create (name, 0) || (fd = open (name)) < 2)
+    fail ("create \"%s\" failed", name);
+  return fd;
+}
+
+void
+test_main (void)
+{
+  uint64_t start, buffered, in_kernel;
+  int in_fd, out_fd, n;
+  size_t i;
+
+  random_init (0);
+  random_bytes (data, sizeof data);
+  in_fd = create_open ("original");
+  if (write (in_fd, data, sizeof data) != sizeof data)
+    fail ("write \"original\" failed");
+  close (in_fd);
+
+  /* Through a user buffer. */
+  in_fd = open ("original");
+  out_fd = create_open ("buffered");
+  start = rdtsc ();
+  while ((n = read (in_fd, buf, sizeof buf)) > 0)
+    if (write (out_fd, buf, n) != n)
+      fail ("write \"buffered\" failed");
+  buffered = rdtsc () - start;
+  close (in_fd);
+  close (out_fd);
+
+  /* Inside the kernel. */
+  in_fd = open ("original");
+  out_fd = create_open ("copied");
+  start = rdtsc ();
+  for (i = 0; i < FILE_SIZE; i += n)
+    if ((n = copy_file_range (in_fd, out_fd, CHUNK_SIZE)) <= 0)
+      fail ("copy_file_range returned %d", n);
+  in_kernel = rdtsc () - start;
+  if (copy_file_range (in_fd, out_fd, CHUNK_SIZE) != 0)
+    fail ("copy_file_range past end of file did not return 0");
+  close (in_fd);
+  close (out_fd);
+
+  check_copy ("buffered", 0, 0, FILE_SIZE);
+  check_copy ("copied", 0, 0, FILE_SIZE);
+
+  /* Sector offsets differ between the two sides. */
+  in_fd = open ("original");
+  out_fd = create_open ("skewed");
+  seek (in_fd, SKEW);
+  seek (out_fd, SKEW * 3);
+  n = copy_file_range (in_fd, out_fd, FILE_SIZE);
+  if (n != FILE_SIZE - SKEW)
+    fail ("unaligned copy_file_range returned %d", n);
+  close (in_fd);
+  close (out_fd);
+  check_copy ("skewed", SKEW * 3, SKEW, FILE_SIZE - SKEW);
+
+  msg ("copy through buffer: %llu cycles", buffered);
+  msg ("copy_file_range: %llu cycles", in_kernel);
+
+  /* Leave the file system empty. */
+  remove ("original");
+  remove ("buffered");
+  remove ("copied");
+  remove ("skewed");
+}
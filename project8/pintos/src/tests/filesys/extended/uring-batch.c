@@ -0,0 +1,124 @@
+/* Compares opening, reading and closing a set of small files one
+   system call at a time against doing the same work through the
+   submission ring, where each phase costs a single trap.  The
+   contents read both ways are checked. */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 32             /* Small files. */
+
+static char names[FILE_CNT][16];
+static char data[FILE_CNT][16];
+
+/* Checks that DATA[I] holds the name of file I. */
+static void
+check_data (int i)
+{
+  if (strcmp (data[i], names[i]))
+    fail ("\"%s\" read back as \"%s\"", names[i], data[i]);
+}
+
+/* Submits the entries queued on RING and checks that a
+   completion arrives for each.  Completions are consumed by
+   the caller. */
+static void
+submit (struct uring *ring, unsigned cnt)
+{
+  int done = uring_enter (cnt);
+  if (done != (int) cnt)
+    fail ("uring_enter returned %d, expected %u", done, cnt);
+  if (ring->cq_tail - ring->cq_head != cnt)
+    fail ("%u completions posted, expected %u",
+          ring->cq_tail - ring->cq_head, cnt);
+}
+
+/* Queues an entry on RING. */
+static void
+queue (struct uring *ring, int op, int fd, void *buf, unsigned len,
+       unsigned user_data)
+{
+  struct uring_sqe *sqe = &ring->sq[ring->sq_tail % URING_ENTRIES];
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = 0;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+void
+test_main (void)
+{
+  struct uring *ring;
+  int fds[FILE_CNT];
+  uint64_t start, single, batched;
+  int i, fd;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (names[i], sizeof names[i], "f%d", i);
+      if (!create (names[i], 0) || (fd = open (names[i])) < 2)
+        fail ("create \"%s\" failed", names[i]);
+      write (fd, names[i], strlen (names[i]) + 1);
+      close (fd);
+    }
+
+  /* One system call per operation. */
+  start = rdtsc ();
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      fd = open (names[i]);
+      if (fd < 2)
+        fail ("open \"%s\" failed", names[i]);
+      read (fd, data[i], sizeof data[i]);
+      close (fd);
+    }
+  single = rdtsc () - start;
+  for (i = 0; i < FILE_CNT; i++)
+    check_data (i);
+
+  ring = uring_setup ();
+  if (ring == NULL)
+    fail ("uring_setup failed");
+  memset (data, 0, sizeof data);
+
+  /* All opens in one batch, then all reads and closes. */
+  start = rdtsc ();
+  for (i = 0; i < FILE_CNT; i++)
+    queue (ring, URING_OPEN, 0, names[i], 0, i);
+  submit (ring, FILE_CNT);
+  while (ring->cq_head != ring->cq_tail)
+    {
+      struct uring_cqe *cqe = &ring->cq[ring->cq_head++ % URING_ENTRIES];
+      fds[cqe->user_data] = cqe->result;
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      if (fds[i] < 2)
+        fail ("open \"%s\" failed", names[i]);
+      queue (ring, URING_READ, fds[i], data[i], sizeof data[i], i);
+      queue (ring, URING_CLOSE, fds[i], NULL, 0, i);
+    }
+  submit (ring, 2 * FILE_CNT);
+  batched = rdtsc () - start;
+  while (ring->cq_head != ring->cq_tail)
+    {
+      struct uring_cqe *cqe = &ring->cq[ring->cq_head++ % URING_ENTRIES];
+      if (cqe->result < 0)
+        fail ("operation on \"%s\" failed", names[cqe->user_data]);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    check_data (i);
+
+  msg ("one call per operation: %llu cycles", single);
+  msg ("batched through ring: %llu cycles", batched);
+
+  /* Leave the file system empty. */
+  for (i = 0; i < FILE_CNT; i++)
+    remove (names[i]);
+}
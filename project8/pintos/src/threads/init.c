@@ -34,6 +34,7 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -52,6 +53,11 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk, -ramdisk-image: Size in sectors of RAM disk to create,
+   and name of block device to fill it from. */
+static size_t ramdisk_sectors;
+static const char *ramdisk_image;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -123,6 +129,7 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  ramdisk_init (ramdisk_sectors, ramdisk_image);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -252,6 +259,10 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_sectors = atoi (value);
+      else if (!strcmp (name, "-ramdisk-image"))
+        ramdisk_image = value;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -377,6 +388,8 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  -ramdisk=SECTORS   Create RAM disk ram0 with SECTORS sectors.\n"
+          "  -ramdisk-image=BDEV  Fill ram0 with a copy of BDEV.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
@@ -212,6 +212,7 @@ thread_create (const char *name, int priority,
   intr_set_level (old_level);
   /* Set Value */
   t->next_fd = 2;
+  t->uring = NULL;
   t->file_descriptor = palloc_get_page(0);
   if(t->file_descriptor == NULL)
 	  return TID_ERROR;
@@ -107,6 +107,7 @@ struct thread
     /* VALUE */
 	struct file **file_descriptor;
 	int next_fd;
+	struct uring *uring;		/* kernel address of system call ring */
 	bool load_success;
 	bool process_exit;
 	int process_exit_status;
@@ -12,6 +12,11 @@
 #include <devices/input.h>
 #include "filesys/inode.h"
 #include "filesys/filesys.h"
+#include "filesys/buffer_cache.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "userprog/pagedir.h"
+#include "threads/vaddr.h"
 static void syscall_handler (struct intr_frame *);
 
 void
@@ -70,12 +75,12 @@ syscall_handler (struct intr_frame *f )
 		  break;
 	  case SYS_READ:
 		  get_argument(esp,arg,3);
-		  check_address((void *)arg[1]);
+		  check_buffer((void *)arg[1], (unsigned)arg[2]);
 		  f->eax = read(arg[0],(void *)arg[1],(unsigned)arg[2]);
 		  break;
 	  case SYS_WRITE:
 		  get_argument(esp,arg,3);
-		  check_address((void *)arg[1]);
+		  check_buffer((void *)arg[1], (unsigned)arg[2]);
 		  f->eax = write(arg[0],(void *)arg[1],(unsigned)arg[2]);
 		  break;
 	  case SYS_SEEK:
@@ -109,6 +114,41 @@ syscall_handler (struct intr_frame *f )
 		  check_address((void *)arg[0]);
 		  f->eax = sys_chdir((const char *)arg[0]);
 		  break;
+	  case SYS_PREAD:
+		  get_argument(esp, arg, 4);
+		  check_buffer((void *)arg[1], (unsigned)arg[2]);
+		  f->eax = sys_pread(arg[0], (void *)arg[1], (unsigned)arg[2], (unsigned)arg[3]);
+		  break;
+	  case SYS_PWRITE:
+		  get_argument(esp, arg, 4);
+		  check_buffer((void *)arg[1], (unsigned)arg[2]);
+		  f->eax = sys_pwrite(arg[0], (const void *)arg[1], (unsigned)arg[2], (unsigned)arg[3]);
+		  break;
+	  case SYS_READV:
+		  get_argument(esp, arg, 3);
+		  f->eax = sys_readv(arg[0], (const struct iovec *)arg[1], arg[2]);
+		  break;
+	  case SYS_WRITEV:
+		  get_argument(esp, arg, 3);
+		  f->eax = sys_writev(arg[0], (const struct iovec *)arg[1], arg[2]);
+		  break;
+	  case SYS_URING_SETUP:
+		  f->eax = (uint32_t)sys_uring_setup();
+		  break;
+	  case SYS_URING_ENTER:
+		  get_argument(esp, arg, 1);
+		  f->eax = sys_uring_enter((unsigned)arg[0]);
+		  break;
+	  case SYS_COPY_FILE_RANGE:
+		  get_argument(esp, arg, 3);
+		  f->eax = sys_copy_file_range(arg[0], arg[1], (unsigned)arg[2]);
+		  break;
+	  case SYS_FSSTAT:
+		  get_argument(esp, arg, 2);
+		  check_address((void *)arg[1]);
+		  check_address((void *)arg[1] + sizeof(struct fsstat) - 1);
+		  f->eax = sys_fsstat(arg[0], (struct fsstat *)arg[1]);
+		  break;
   }
 }
 /* chack_address function */
@@ -126,6 +166,26 @@ check_address(void *addr)
 		exit(-1);
 	}
 }
+/* check every page of buffer is in user address space and mapped,
+   so that copying it can not fault while holding a file system lock */
+void
+check_buffer(const void *buffer, unsigned size)
+{
+	struct thread *cur = thread_current();
+	const void *page;
+
+	check_address((void *)buffer);
+	if(size > 0)
+	{
+		/* buffer must not wrap around */
+		if((uint32_t)buffer + size - 1 < (uint32_t)buffer)
+			exit(-1);
+		check_address((void *)buffer + size - 1);
+		for(page = pg_round_down(buffer); page < buffer + size; page += PGSIZE)
+			if(pagedir_get_page(cur->pagedir, page) == NULL)
+				exit(-1);
+	}
+}
 /* get_argument function */
 void
 get_argument(void *esp, int *arg, int count)
@@ -412,3 +472,299 @@ uint32_t sys_inumber(int fd)
 	/* if file is not exist, return -1*/
 	return -1;
 }
+
+/* get file system statistics. byte counts are of fd's inode,
+   or of all inodes if fd is not open */
+bool sys_fsstat(int fd, struct fsstat *st)
+{
+	struct file *file = NULL;
+	struct inode *inode = NULL;
+	struct fsstat kst;
+
+	if(fd >= 0)
+		file = process_get_file(fd);
+	if(file != NULL)
+		inode = file_get_inode(file);
+	/* fill a kernel copy under the locks, a fault on st while
+	   holding them would never release them */
+	bc_get_stats(&kst);
+	inode_get_stats(inode, &kst);
+	*st = kst;
+	return true;
+}
+
+/* get writable regular file of fd, or NULL */
+static struct file *get_write_file(int fd)
+{
+	struct file *file = process_get_file(fd);
+	if(file == NULL || inode_is_dir(file_get_inode(file)) == true)
+		return NULL;
+	return file;
+}
+
+/* true if size bytes at offset fit in off_t */
+static bool valid_range(unsigned size, unsigned offset)
+{
+	return offset <= INT32_MAX && size <= INT32_MAX - offset;
+}
+
+/* read file at offset, without moving file position */
+int sys_pread(int fd, void *buffer, unsigned size, unsigned offset)
+{
+	int read_size = -1;
+	struct file *file;
+
+	if(valid_range(size, offset) == false)
+		return -1;
+	lock_acquire(&file_lock);
+	file = fd >= 2 ? process_get_file(fd) : NULL;
+	if(file != NULL)
+		read_size = file_read_at(file, buffer, size, offset);
+	lock_release(&file_lock);
+	return read_size;
+}
+
+/* write file at offset, without moving file position */
+int sys_pwrite(int fd, const void *buffer, unsigned size, unsigned offset)
+{
+	int write_size = -1;
+	struct file *file;
+
+	if(valid_range(size, offset) == false)
+		return -1;
+	lock_acquire(&file_lock);
+	file = fd >= 2 ? get_write_file(fd) : NULL;
+	if(file != NULL)
+		write_size = file_write_at(file, buffer, size, offset);
+	lock_release(&file_lock);
+	return write_size;
+}
+
+/* copy from position of fd_in to position of fd_out inside the
+   kernel, without a user buffer */
+int sys_copy_file_range(int fd_in, int fd_out, unsigned size)
+{
+	int copy_size = -1;
+	struct file *in, *out;
+
+	/* length does not fit off_t, copy what does */
+	if(size > INT32_MAX)
+		size = INT32_MAX;
+	lock_acquire(&file_lock);
+	in = fd_in >= 2 ? get_write_file(fd_in) : NULL;
+	out = fd_out >= 2 ? get_write_file(fd_out) : NULL;
+	if(in != NULL && out != NULL)
+		copy_size = file_copy(out, in, size);
+	lock_release(&file_lock);
+	return copy_size;
+}
+
+/* copy iovec array from user and check every buffer.
+   return total length of buffers */
+static unsigned copy_iovec(struct iovec *kiov, const struct iovec *iov, int iovcnt)
+{
+	unsigned total = 0;
+	int i;
+
+	if(iovcnt < 0 || iovcnt > IOV_MAX)
+		exit(-1);
+	check_buffer(iov, iovcnt * sizeof *iov);
+	memcpy(kiov, iov, iovcnt * sizeof *iov);
+	for(i=0; i<iovcnt; i++)
+	{
+		check_buffer(kiov[i].iov_base, kiov[i].iov_len);
+		if(total + kiov[i].iov_len < total)
+			exit(-1);
+		total += kiov[i].iov_len;
+	}
+	return total;
+}
+
+/* read file into several buffers with one inode read through a
+   kernel buffer. large requests are read buffer by buffer */
+int sys_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec kiov[IOV_MAX];
+	struct file *file;
+	unsigned total;
+	char *bounce = NULL;
+	int read_size = -1;
+	int i, done, chunk;
+
+	total = copy_iovec(kiov, iov, iovcnt);
+	if(total <= IOV_BOUNCE_MAX)
+		bounce = malloc(total > 0 ? total : 1);
+	lock_acquire(&file_lock);
+	file = fd >= 2 ? process_get_file(fd) : NULL;
+	if(file != NULL && bounce != NULL)
+	{
+		read_size = file_read(file, bounce, total);
+		/* scatter to user buffers */
+		for(i=0, done=0; i<iovcnt && done < read_size; i++)
+		{
+			chunk = read_size - done < (int)kiov[i].iov_len ? read_size - done : (int)kiov[i].iov_len;
+			memcpy(kiov[i].iov_base, bounce + done, chunk);
+			done += chunk;
+		}
+	}
+	else if(file != NULL)
+	{
+		read_size = 0;
+		for(i=0; i<iovcnt; i++)
+		{
+			chunk = file_read(file, kiov[i].iov_base, kiov[i].iov_len);
+			read_size += chunk;
+			if(chunk < (int)kiov[i].iov_len)
+				break;
+		}
+	}
+	lock_release(&file_lock);
+	free(bounce);
+	return read_size;
+}
+
+/* write several buffers to file with one inode write through a
+   kernel buffer, so the data is written at once. large requests are
+   written buffer by buffer */
+int sys_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec kiov[IOV_MAX];
+	struct file *file;
+	unsigned total;
+	char *bounce = NULL;
+	int write_size = -1;
+	int i, done, chunk;
+
+	total = copy_iovec(kiov, iov, iovcnt);
+	if(total <= IOV_BOUNCE_MAX)
+		bounce = malloc(total > 0 ? total : 1);
+	/* gather user buffers */
+	if(bounce != NULL)
+		for(i=0, done=0; i<iovcnt; i++)
+		{
+			memcpy(bounce + done, kiov[i].iov_base, kiov[i].iov_len);
+			done += kiov[i].iov_len;
+		}
+	lock_acquire(&file_lock);
+	if(fd == 1)                    /* stdout */
+	{
+		if(bounce != NULL)
+			putbuf(bounce, total);
+		else
+			for(i=0; i<iovcnt; i++)
+				putbuf(kiov[i].iov_base, kiov[i].iov_len);
+		write_size = total;
+	}
+	else if((file = fd >= 2 ? get_write_file(fd) : NULL) != NULL)
+	{
+		if(bounce != NULL)
+			write_size = file_write(file, bounce, total);
+		else
+		{
+			write_size = 0;
+			for(i=0; i<iovcnt; i++)
+			{
+				chunk = file_write(file, kiov[i].iov_base, kiov[i].iov_len);
+				write_size += chunk;
+				if(chunk < (int)kiov[i].iov_len)
+					break;
+			}
+		}
+	}
+	lock_release(&file_lock);
+	free(bounce);
+	return write_size;
+}
+
+/* map a zeroed page for the system call ring at URING_ADDR and
+   return its user address, or NULL. the page stays mapped, and
+   so resident, until the process exits */
+void *sys_uring_setup(void)
+{
+	struct thread *cur = thread_current();
+	void *kpage;
+
+	if(cur->uring != NULL)
+		return URING_ADDR;
+	if(pagedir_get_page(cur->pagedir, URING_ADDR) != NULL)
+		return NULL;
+	kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	if(kpage == NULL)
+		return NULL;
+	if(!pagedir_set_page(cur->pagedir, URING_ADDR, kpage, true))
+	{
+		palloc_free_page(kpage);
+		return NULL;
+	}
+	cur->uring = kpage;
+	return URING_ADDR;
+}
+
+/* carry out one submission entry and return its result */
+static int uring_do(const struct uring_sqe *sqe)
+{
+	switch(sqe->op)
+	{
+		case URING_NOP:
+			return 0;
+		case URING_OPEN:
+			check_address(sqe->buf);
+			return open(sqe->buf);
+		case URING_CLOSE:
+			close(sqe->fd);
+			return 0;
+		case URING_READ:
+			check_buffer(sqe->buf, sqe->len);
+			return read(sqe->fd, sqe->buf, sqe->len);
+		case URING_WRITE:
+			check_buffer(sqe->buf, sqe->len);
+			return write(sqe->fd, sqe->buf, sqe->len);
+		case URING_PREAD:
+			check_buffer(sqe->buf, sqe->len);
+			return sys_pread(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+		case URING_PWRITE:
+			check_buffer(sqe->buf, sqe->len);
+			return sys_pwrite(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+		case URING_FILESIZE:
+			return filesize(sqe->fd);
+		default:
+			return -1;
+	}
+}
+
+/* carry out up to TO_SUBMIT queued entries of the ring, posting a
+   completion for each, while the completion ring has room.
+   return the number carried out, or -1 if there is no ring or
+   its indexes are corrupt */
+int sys_uring_enter(unsigned to_submit)
+{
+	struct uring *ring = thread_current()->uring;
+	unsigned sq_head, sq_tail, cq_tail;
+	int done = 0;
+
+	if(ring == NULL)
+		return -1;
+	/* the process may change the ring at any time, so read each
+	   index and entry once */
+	sq_head = ring->sq_head;
+	sq_tail = ring->sq_tail;
+	cq_tail = ring->cq_tail;
+	if(sq_tail - sq_head > URING_ENTRIES
+		|| cq_tail - ring->cq_head > URING_ENTRIES)
+		return -1;
+	while(sq_head != sq_tail && (unsigned)done < to_submit
+		&& cq_tail - ring->cq_head < URING_ENTRIES)
+	{
+		struct uring_sqe sqe = ring->sq[sq_head % URING_ENTRIES];
+		struct uring_cqe *cqe = &ring->cq[cq_tail % URING_ENTRIES];
+
+		cqe->result = uring_do(&sqe);
+		cqe->user_data = sqe.user_data;
+		sq_head++;
+		cq_tail++;
+		ring->sq_head = sq_head;
+		ring->cq_tail = cq_tail;
+		done++;
+	}
+	return done;
+}
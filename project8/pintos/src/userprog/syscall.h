@@ -1,10 +1,20 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 #include "threads/thread.h"
+#include <fsstat.h>
+#include <uio.h>
+#include <uring.h>
+
+/* user address where the system call ring is mapped */
+#define URING_ADDR ((void *) 0x10000000)
+
+/* readv and writev up to this many bytes use one inode operation */
+#define IOV_BOUNCE_MAX (64 * 1024)
 void syscall_init (void);
 
 /* add function */
 void check_address(void *addr);
+void check_buffer(const void *buffer, unsigned size);
 void get_argument(void *esp, int *arg, int count);
 
 void halt(void);
@@ -25,6 +35,14 @@ bool sys_chdir(const char *dir);
 bool sys_mkdir(const char *dir);
 bool sys_readdir(int fd, char *name);
 uint32_t sys_inumber(int fd);
+bool sys_fsstat(int fd, struct fsstat *st);
+int sys_pread(int fd, void *buffer, unsigned size, unsigned offset);
+int sys_pwrite(int fd, const void *buffer, unsigned size, unsigned offset);
+int sys_readv(int fd, const struct iovec *iov, int iovcnt);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt);
+void *sys_uring_setup(void);
+int sys_uring_enter(unsigned to_submit);
+int sys_copy_file_range(int fd_in, int fd_out, unsigned size);
 /* */
 
 #endif /* userprog/syscall.h */